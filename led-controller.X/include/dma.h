@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 
+#define DMA_MEM_QUEUE_SIZE  4 // Number of memory requests that can be queued, requests are refused while no channel is left
+
 struct dma_channel;
 struct dma_event
 {
@@ -10,6 +12,15 @@ struct dma_event
     bool enable;
 };
 
+struct dma_crc
+{
+    unsigned int polynomial;
+    unsigned int seed;
+    unsigned char length; // Polynomial length in bits, up to 32
+    bool swap_bytes; // Reverse the byte order of each word, the swapped words are also written to the destination
+    bool enable;
+};
+
 struct dma_config
 {
     void (*block_transfer_complete)(struct dma_channel*);
@@ -22,6 +33,7 @@ struct dma_config
     
     struct dma_event abort_event;
     struct dma_event start_event;
+    struct dma_crc crc;
 };
 
 void dma_init(void);
@@ -33,6 +45,12 @@ void dma_configure_dst(struct dma_channel* channel, const void* mem, unsigned sh
 void dma_configure_cell(struct dma_channel* channel, unsigned short size);
 void dma_configure_start_event(struct dma_channel* channel, struct dma_event event);
 void dma_configure_abort_event(struct dma_channel* channel, struct dma_event event);
+bool dma_configure_crc(struct dma_channel* channel, struct dma_crc crc);
+void dma_crc_reset(struct dma_channel* channel);
+unsigned int dma_crc_result(struct dma_channel* channel);
+bool dma_mem_fill(void* dst, unsigned char value, unsigned short size, void (*complete)(void));
+bool dma_mem_copy(void* dst, const void* src, unsigned short size, void (*complete)(void));
+bool dma_mem_busy(void);
 void dma_enable_transfer(struct dma_channel* channel);
 bool dma_busy(struct dma_channel* channel);
 bool dma_ready(struct dma_channel* channel);
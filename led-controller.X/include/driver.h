@@ -0,0 +1,45 @@
+#ifndef DRIVER_H
+#define	DRIVER_H
+
+#include <stdbool.h>
+
+#define DRIVER_TLC5940                  0
+#define DRIVER_TLC5941                  1
+#define DRIVER_TLC5947                  2
+#define DRIVER_TLC5955                  3
+
+#include "driver_config.h"
+
+#if (DRIVER == DRIVER_TLC5940) || (DRIVER == DRIVER_TLC5941)
+#include "tlc5940.h"
+#include "tlc5940_config.h"
+
+#define DRIVER_NUM_OF_DEVICES           TLC5940_NUM_OF_DEVICES
+#define DRIVER_CHANNELS_PER_DEVICE      16
+#define DRIVER_GRAYSCALE_BITS           12
+#define DRIVER_DOT_CORRECTION_SIZE      (12 * TLC5940_NUM_OF_DEVICES) // 6 bit dot correction of each channel
+
+inline static void __attribute__((always_inline)) driver_early_init(void) { tlc5940_early_init(); }
+inline static bool __attribute__((always_inline)) driver_ready(void) { return tlc5940_ready(); }
+inline static bool __attribute__((always_inline)) driver_update(void) { return tlc5940_update(); }
+inline static bool __attribute__((always_inline)) driver_update_raw(const unsigned char* buffer, unsigned int size) { return tlc5940_update_raw(buffer, size); }
+inline static void __attribute__((always_inline)) driver_set_latch_callback(void (*callback)(void)) { tlc5940_set_latch_callback(callback); }
+inline static void __attribute__((always_inline)) driver_set_cycle_time(unsigned int time) { tlc5940_set_cycle_time(time); }
+inline static bool __attribute__((always_inline)) driver_set_clock_limit(unsigned int frequency) { return tlc5940_set_clock_limit(frequency); }
+inline static bool __attribute__((always_inline)) driver_set_dot_correction(const unsigned char* buffer, unsigned int size) { return tlc5940_set_dot_correction(buffer, size); }
+
+inline static void __attribute__((always_inline)) driver_write_grayscale(unsigned int device, unsigned int channel, unsigned int value)
+{
+    // Convert 8.8 fixed point to the 12 bit equivalent
+    tlc5940_write_grayscale(device, channel, (value >> 4) | (value >> 12));
+}
+#elif (DRIVER == DRIVER_TLC5947) || (DRIVER == DRIVER_TLC5955)
+    #error "LED driver backend is not supported yet, see driver_config.h"
+#else
+    #error "LED driver backend is not specified, please define 'DRIVER'"
+#endif
+
+#define DRIVER_NUM_OF_CHANNELS          (DRIVER_CHANNELS_PER_DEVICE * DRIVER_NUM_OF_DEVICES)
+#define DRIVER_RAW_SIZE                 ((DRIVER_NUM_OF_CHANNELS * DRIVER_GRAYSCALE_BITS) / 8) // Grayscale bitstream of all devices
+
+#endif	/* DRIVER_H */
\ No newline at end of file
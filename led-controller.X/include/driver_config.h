@@ -0,0 +1,14 @@
+#ifndef DRIVER_CONFIG_H
+#define	DRIVER_CONFIG_H
+
+// Notes:
+// - The LED driver backend is selected at compile time. The driver interface in driver.h maps directly onto the
+//   functions of the backend, so the multiplexer and the frame pipeline in layer.c are shared without any dispatch
+//   overhead
+// - The TLC5941 shares the TLC5940 backend, the grayscale and dot correction data are shifted in the same format
+// - The TLC5947 and TLC5955 are not supported yet. Supporting them requires a backend that packs grayscale data in its
+//   native format (24 channels of 12 bit, respectively 48 channels of 16 bit and control data latched per device)
+
+#define DRIVER                      DRIVER_TLC5940  // LED driver backend
+
+#endif	/* DRIVER_CONFIG_H */
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef FIRMWARE_H
+#define	FIRMWARE_H
+
+#include <stdbool.h>
+
+#define FIRMWARE_SLOT_NONE          (-1)
+
+enum firmware_status
+{
+    FIRMWARE_STATUS_IDLE = 0,
+    FIRMWARE_STATUS_BUSY,
+    FIRMWARE_STATUS_DONE,
+    FIRMWARE_STATUS_ERROR
+};
+
+int firmware_running_slot(void);
+int firmware_boot_slot(void);
+void firmware_boot_attempt(int slot);
+void firmware_confirm(void);
+bool firmware_update_begin(unsigned int size, unsigned int crc, unsigned int version);
+unsigned int firmware_update_write(const unsigned char* data, unsigned int size);
+void firmware_update_abort(void);
+enum firmware_status firmware_update_status(void);
+
+#endif	/* FIRMWARE_H */
\ No newline at end of file
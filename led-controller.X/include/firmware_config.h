@@ -0,0 +1,37 @@
+#ifndef FIRMWARE_CONFIG_H
+#define	FIRMWARE_CONFIG_H
+
+#include "nvm.h"
+
+// Notes:
+// - A/B updates need a resident bootloader and a slot B link, neither exist yet: both slots share the reset code and
+//   exception vectors in boot flash, which are linked for slot A. An image written to slot B would never run, so the
+//   whole feature (slot selection, row buffers, update task and the UART command) is compiled out unless
+//   FIRMWARE_UPDATE is set. Enabling it also requires limiting kseg0_program_mem of the linker script to slot A
+// - The program flash is split in two slots of equal size, the remaining pages are reserved for the store. The last row of each slot holds the slot info, see
+//   struct firmware_slot_info. An update is always written to the slot the application isn't running from. The slot
+//   info is written last, only after the image read back from flash matches the CRC, so an interrupted update never
+//   leaves a slot behind that looks valid
+// - A resident bootloader in boot flash picks the slot with firmware_boot_slot() and consumes a boot attempt with
+//   firmware_boot_attempt() before jumping to it. The application confirms the slot with firmware_confirm() once it
+//   is up and running. A slot that used up all its attempts without being confirmed is skipped, so the bootloader
+//   falls back to the other slot. The factory image in slot A (programmed with a programmer, without slot info) is
+//   booted once no slot is bootable, as long as slot A isn't erased
+// - Each slot is linked to its own address, the linker script of this project places the application in slot A
+// - The image CRC is a CRC-32 (reflected, 0xedb88320, seed and final XOR 0xffffffff) over the image size in bytes
+// - UART update: the master sends 'U' followed by the image size, CRC and version (32 bit little endian each). The
+//   controller answers 'K' once the slot is erased, or 'E' if the update can't be started. Then the master sends the
+//   image in blocks of one row (the last block may be shorter) and waits for a 'K' after each block. A block is only
+//   acknowledged once it is programmed, as programming stalls the CPU and the UART would overrun otherwise. Finally
+//   the controller answers 'D' once the image is verified, or 'E' on an error. The update is aborted on a receive
+//   error or if the master doesn't send anything for the timeout, so the flash is released for the store again
+
+#define FIRMWARE_UPDATE             0           // Set to 1 to enable A/B slots and firmware updates, set to 0 to disable
+#define FIRMWARE_SLOT_A             0x1D000000  // Physical address of slot A
+#define FIRMWARE_SLOT_B             0x1D007000  // Physical address of slot B
+#define FIRMWARE_SLOT_SIZE          0x7000      // Size of a slot in bytes, a multiple of the page size
+#define FIRMWARE_BOOT_ATTEMPTS      3           // Number of unconfirmed boots before falling back to the other slot
+#define FIRMWARE_UART               0           // Set to 1 to accept updates over UART (requires FIRMWARE_UPDATE), set to 0 to disable
+#define FIRMWARE_UART_TIMEOUT       1000        // Time without progress before an update is aborted in ms
+
+#endif	/* FIRMWARE_CONFIG_H */
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef INTERRUPT_H
+#define	INTERRUPT_H
+
+#include "interrupt_config.h"
+
+// Value of the priority and subpriority field of an IPC register
+#define INT_IPC(priority, subpriority)      ((((priority) & 0x7) << 2) | ((subpriority) & 0x3))
+#define INT_IPC_MASK                        0x1f
+
+// ISR attribute that matches the priority, e.g. __ISR(vector, INT_IPL(INT_DMA_PRIORITY))
+#define INT_IPL(priority)                   __INT_IPL_EXPAND(priority)
+#define __INT_IPL_EXPAND(priority)          __INT_IPL(priority, __INT_CONTEXT_##priority)
+#define __INT_IPL(priority, context)        __INT_IPL_PASTE(priority, context)
+#define __INT_IPL_PASTE(priority, context)  IPL##priority##context
+
+// Context save per priority, only the shadow register set priority is SRS
+#define __INT_CONTEXT_1                     SOFT
+#define __INT_CONTEXT_2                     SOFT
+#define __INT_CONTEXT_3                     SOFT
+#define __INT_CONTEXT_4                     SOFT
+#define __INT_CONTEXT_5                     SOFT
+#define __INT_CONTEXT_6                     SOFT
+#define __INT_CONTEXT_7                     SRS
+
+#endif	/* INTERRUPT_H */
\ No newline at end of file
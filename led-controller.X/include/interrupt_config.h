@@ -0,0 +1,17 @@
+#ifndef INTERRUPT_CONFIG_H
+#define	INTERRUPT_CONFIG_H
+
+// Notes:
+// - This is the only place where interrupt priorities are assigned. The IPC registers and the ISR attributes are both
+//   generated from these, see interrupt.h
+// - The shadow register set is assigned to priority 7 (FSRSSEL in config_word.c). ISRs at priority 7 are declared SRS
+//   and skip saving the general purpose registers, all other ISRs are declared SOFT
+// - The PWM ISR pulses BLANK at the end of every grayscale cycle. It must not wait for another ISR, any delay stretches
+//   the last GSCLK period and shows as flicker. See pwm_statistics() for the measured entry latency
+
+#define INT_PWM_PRIORITY        7   // Priority of the PWM period ISR (BLANK pulse)
+#define INT_PWM_SUBPRIORITY     0   // Subpriority of the PWM period ISR
+#define INT_DMA_PRIORITY        3   // Priority of the DMA channel ISRs
+#define INT_DMA_SUBPRIORITY     0   // Subpriority of the DMA channel ISRs
+
+#endif	/* INTERRUPT_CONFIG_H */
\ No newline at end of file
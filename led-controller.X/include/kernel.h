@@ -1,7 +1,23 @@
 #ifndef KERNEL_H
 #define	KERNEL_H
 
+#include "stack.h"
+#include <stdbool.h>
+
+struct kernel_statistics
+{
+    bool schedule_table;        // Whether ttasks are dispatched from the schedule table
+    unsigned int minor_frame;   // Minor frame of the schedule table in us
+    unsigned int major_frame;   // Major frame of the schedule table in us
+    unsigned int overruns;      // Number of minor frames that started late
+    unsigned int releases;      // Number of ttask releases
+    unsigned int coincident;    // Number of releases that were dispatched along with another ttask
+    unsigned int lateness;      // Longest time from the due time of a release to its dispatch in us
+    struct stack_statistics stack;  // Usage of the stack
+};
+
 void kernel_init(void);
 void kernel_execute(void);
+struct kernel_statistics kernel_statistics(void);
 
 #endif	/* KERNEL_H */
\ No newline at end of file
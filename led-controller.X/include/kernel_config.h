@@ -12,4 +12,23 @@
 #define KERN_TMR_EN_BIT         BIT(15)         // Hardware timer enable mask of the configuration word
 #define KERN_TMR_CLKIN_FREQ     SYS_PB_CLOCK    // Hardware timer input frequency (can be calculated with SYS_CLK / PB_DIV)
 
+// Notes:
+// - With the schedule table enabled, ttasks are dispatched from a table of minor frames that is computed at init. The
+//   minor frame is the greatest common divisor of all intervals, the major frame their least common multiple. The
+//   table is rejected if it doesn't fit or if the budgets of the ttasks released in a minor frame exceed the minor
+//   frame. A changed interval rebuilds the table at the end of the major frame. As long as no table can be built,
+//   the ttasks are dispatched as usual. See kernel_statistics() for the outcome
+// - The table releases ttasks at the start of a minor frame, so their phases are rounded down to a minor frame and
+//   the ttasks released in the same minor frame run back to back in order of priority. With the timer (500 us, 50 us
+//   budget) and the layer (750 us, 150 us budget) the minor frame is 250 us and the major frame 1.5 ms. The busiest
+//   minor frame releases both, 200 us of budget. While the governor uses an interval that isn't a multiple of 250 us
+//   the table doesn't fit, and the ttasks are dispatched as usual
+// - Ttasks without an explicit phase are spread over the greatest common divisor of all intervals at init, in order
+//   of priority. Ttasks with harmonic intervals and distinct phases within that divisor are never released at the
+//   same time. An interval that changes at runtime keeps the current phase, but may cause coincident releases again
+
+#define KERN_SCHEDULE_TABLE     0               // Set to 1 to dispatch ttasks from a schedule table, set to 0 to disable
+#define KERN_SCHEDULE_SLOTS     32              // Maximum number of minor frames in a major frame
+#define KERN_SCHEDULE_ENTRIES   64              // Maximum number of ttask releases in a major frame
+
 #endif	/* KERNEL_CONFIG_H */
\ No newline at end of file
@@ -7,7 +7,9 @@
             static struct kernel_rtask_param                                    \
             __attribute__ ((__used__)) __rtask_param_##name =                   \
             {                                                                   \
-                .init_done = false                                              \
+                .init_done = false,                                             \
+                .wait_event = ((void*)0),                                       \
+                .wait_mask = 0                                                  \
             };                                                                  \
             static const struct kernel_rtask __rtask_##name                     \
             __attribute__ ((section(".kernel_rstack"), __used__)) =             \
@@ -30,6 +32,8 @@
                 .priority = KERN_TTASK_PRIORITY_NORMAL,                         \
                 .ticks = 0,                                                     \
                 .interval = 0x7fffffffL,                                        \
+                .budget = 0,                                                    \
+                .phase = KERN_TTASK_PHASE_AUTO,                                 \
                 .next = ((void*)0)                                              \
             };                                                                  \
             static const struct kernel_ttask __ttask_##name                     \
@@ -45,6 +49,12 @@
 #define KERN_QUICK_TTASK(name, init_func, exec_func)                            \
             KERN_TTASK(name, init_func, exec_func, ((void*)0), KERN_INIT_LATE)
 
+#define KERN_EVENT(name)                                                        \
+            static struct kernel_event name =                                   \
+            {                                                                   \
+                .flags = 0                                                      \
+            };
+
 enum 
 {
     KERN_INIT_LATE = 0,
@@ -70,6 +80,11 @@ enum
     __KERN_TTASK_PRIORITY_COUNT
 };
 
+enum
+{
+    KERN_TTASK_PHASE_AUTO = -1, // Spread at init
+};
+
 enum
 {
     KERN_TIME_UNIT_S = 0,
@@ -77,9 +92,16 @@ enum
     KERN_TIME_UNIT_US
 };
 
+struct kernel_event
+{
+    volatile unsigned int flags;
+};
+
 struct kernel_rtask_param
 {
     bool init_done;
+    const struct kernel_event* wait_event; // Only dispatched if one of the awaited flags is set
+    unsigned int wait_mask;
 };
 
 struct kernel_rtask
@@ -98,6 +120,8 @@ struct kernel_ttask_param
     int priority;
     int ticks;
     int interval;
+    int budget; // Worst case execution time, 0 if unknown
+    int phase; // Offset of the first release
     
     const struct kernel_ttask* next;
 };
@@ -114,5 +138,11 @@ struct kernel_ttask
 
 void kernel_ttask_set_priority(struct kernel_ttask_param* const ttask_param, int priority);
 void kernel_ttask_set_interval(struct kernel_ttask_param* const ttask_param, int time, int unit);
+void kernel_ttask_set_budget(struct kernel_ttask_param* const ttask_param, int time, int unit);
+void kernel_ttask_set_phase(struct kernel_ttask_param* const ttask_param, int time, int unit);
+void kernel_rtask_wait(struct kernel_rtask_param* const rtask_param, const struct kernel_event* event, unsigned int mask);
+void kernel_event_set(struct kernel_event* event, unsigned int mask);
+void kernel_event_clear(struct kernel_event* event, unsigned int mask);
+unsigned int kernel_event_take(struct kernel_event* event, unsigned int mask);
 
 #endif	/* KERNEL_TASK_H */
\ No newline at end of file
@@ -3,9 +3,76 @@
 
 #include <stdbool.h>
 
+// Layout of an RGB frame and the canvas: the red, green and blue planes with a byte per LED, row major
+#define LAYER_NUM_OF_ROWS           16
+#define LAYER_NUM_OF_COLS           16
+#define LAYER_NUM_OF_LEDS           (LAYER_NUM_OF_ROWS * LAYER_NUM_OF_COLS)
+#define LAYER_RED_OFFSET            (LAYER_NUM_OF_LEDS * 0)
+#define LAYER_GREEN_OFFSET          (LAYER_NUM_OF_LEDS * 1)
+#define LAYER_BLUE_OFFSET           (LAYER_NUM_OF_LEDS * 2)
+#define LAYER_GAMMA_SIZE            256 // Entries of the gamma table, one per 8 bit value
+#define LAYER_NUM_OF_ADDRESSES      16 // Boards that can share the bus, see layer_set_address()
+#define LAYER_DEAD_TIME_MAX         10000 // Longest row dead-time in ns, see layer_set_dead_time()
+
+// Orientation of the board, combine to rotate (described as where each output LED takes its value from)
+#define LAYER_REMAP_NONE            0
+#define LAYER_REMAP_MIRROR_COLS     0x1 // Mirror the columns
+#define LAYER_REMAP_MIRROR_ROWS     0x2 // Mirror the rows
+#define LAYER_REMAP_TRANSPOSE       0x4 // Swap rows and columns, applied before mirroring
+#define LAYER_REMAP_ROTATE_90       (LAYER_REMAP_TRANSPOSE | LAYER_REMAP_MIRROR_ROWS)
+#define LAYER_REMAP_ROTATE_180      (LAYER_REMAP_MIRROR_ROWS | LAYER_REMAP_MIRROR_COLS)
+#define LAYER_REMAP_ROTATE_270      (LAYER_REMAP_TRANSPOSE | LAYER_REMAP_MIRROR_COLS)
+#define LAYER_REMAP_MASK            0x7
+
+enum layer_pattern
+{
+    LAYER_PATTERN_NONE = 0,         // Show the received frames
+    LAYER_PATTERN_RAMP,             // Every LED at a different level, all levels move along the channels
+    LAYER_PATTERN_CHECKERBOARD,     // Alternating checkerboard
+    LAYER_PATTERN_WALK,             // Single LED walking through all LEDs and colors
+    LAYER_PATTERN_CHASE_ROWS,       // Single row walking through all rows
+    LAYER_PATTERN_CHASE_COLS,       // Single column walking through all columns
+    LAYER_PATTERN_WHITE,            // All LEDs at the same level
+
+    __LAYER_PATTERN_COUNT
+};
+
+struct layer_statistics
+{
+    unsigned int dead_time;         // Longest measured row dead-time in ns
+    unsigned int dead_time_cost;    // Row on-time lost to the dead-time in parts per million
+    unsigned int active_rows;       // Number of rows refreshed in the current scan
+    unsigned int refresh_interval;  // Current refresh interval in us
+    unsigned int deadline_misses;   // Number of rows that were not latched in time
+    unsigned int pack_time;         // Longest time to pack a single row in ns
+    unsigned int frames;            // Number of presented frames
+    unsigned int crc_errors;        // Number of frames dropped because of a CRC mismatch
+    unsigned int header_errors;     // Number of frames dropped because of an unknown type or size
+    unsigned int overruns;          // Number of receive overflows of the SPI module, frames that overflowed are dropped
+    unsigned int payload_delay;     // Longest time from the end of the header until the payload is received in ns
+    unsigned int queued_frames;     // Number of frames waiting for their presentation time
+    unsigned int late_frames;       // Number of frames skipped because a later frame was due as well
+    unsigned int dropped_frames;    // Number of frames dropped because the queue was full
+    unsigned int render_rejects;    // Number of draw frames rejected because the previous commands were still rendering
+    unsigned int foreign_frames;    // Number of frames addressed to another board
+    unsigned int limiter_scale;     // Current brightness scale of the limiter in 1/256
+    unsigned int limited_frames;    // Number of frames that exceeded the current budget
+    unsigned int boot_time;         // Time from the start of main() to the first latched row in us
+};
+
 bool layer_busy(void);
 bool layer_ready(void);
 bool layer_receive_frame(void);
-
+bool layer_set_dead_time(unsigned int dead_time);
+void layer_blank(bool blank);
+bool layer_set_address(unsigned int address);
+void layer_set_gamma(const unsigned short* gamma);
+bool layer_set_refresh_interval(unsigned int interval);
+bool layer_set_remap(unsigned int remap);
+void layer_set_permutation(const unsigned char* permutation);
+bool layer_set_pattern(unsigned int pattern, unsigned int level);
+unsigned char* layer_canvas_begin(void);
+void layer_canvas_commit(void);
+struct layer_statistics layer_statistics(void);
 
 #endif	/* LAYER_H */
\ No newline at end of file
@@ -1,9 +1,126 @@
 #ifndef LAYER_CONFIG_H
 #define	LAYER_CONFIG_H
 
+#include "layer.h"
+
 // Notes:
 // - In order to achieve the desired refresh interval, make sure the TLC5940 uses a sufficient GSCLK PWM frequency
 
-#define LAYER_REFRESH_INTERVAL      750     // Refresh interval between layers in us
+// - The row dead-time is taken while BLANK is high, so it directly reduces the on-time of each row. Tune it per
+//   hardware revision until the ghosting of the previous row disappears, see layer_statistics() for the cost. A
+//   dead-time stored with layer_set_dead_time() replaces the configured dead-time, so a board can be tuned in place
+// - When skipping black rows, the rows with content share the row time of the skipped rows. Sparse frames are
+//   therefore refreshed faster and appear brighter than dense frames
+// - The refresh governor measures the row preparation time, the time to shift and latch a row and the release
+//   lateness of the layer ttask. It picks the shortest refresh interval in between the minimum and the ceiling that
+//   still leaves enough margin, and adjusts the TLC5940 grayscale cycle to the chosen interval. A minimum of 410 us
+//   is needed to fit a full grayscale cycle at the maximum GSCLK frequency. A lower ceiling of the clock profile (see
+//   driver_set_clock_limit()) needs a longer interval, otherwise the next latch cuts the cycle short and the brightest
+//   levels are lost. A refresh interval stored with layer_set_refresh_interval() replaces the configured interval
+// - Frame interpolation blends from the previous to the current frame during row packing, reaching the current frame
+//   one frame interval after it arrived. It keeps a third frame buffer and lags the incoming frames by one frame.
+//   Frames that arrive after a pause longer than the maximum interpolation interval are shown right away
+// - Each frame starts with an 8 byte header: type, flags, the payload size and a timestamp (both little endian).
+//   A frame is either RGB (type 0, 768 bytes: the red, green and blue planes with 8 bits per
+//   LED) or a raw bitstream in the native driver format (type 1, TLC5940: 1152 bytes, 72 bytes of 12 bit grayscale
+//   data per row in shift order). A bitstream is streamed to the driver as is, so the master is responsible for gamma
+//   correction and it is never interpolated. Frames with an unknown type or a mismatching size are dropped
+// - Received frames are queued and presented at the start of a scan once their presentation time has passed. With
+//   flag 0x01 set, the timestamp is the presentation time in us of the master's timebase, otherwise the frame is
+//   presented right away. A sync (type 2, no payload) aligns the timebase, its timestamp is the master's time in us
+//   at the end of the header. Until the first sync all frames are presented right away. Repeat the sync every now
+//   and then to cancel the drift between both clocks. If more frames are due, only the most recent is presented.
+//   If the queue is full, the oldest frame is dropped. Palette frames are never dropped, see below
+// - Up to 16 boards can share the bus. With flag 0x02 set, a frame is only for the board with the address in the
+//   upper nibble of the flags, other boards receive it and drop it. Frames without the flag are for all boards. The
+//   address is LAYER_BOARD_ADDRESS unless stored with layer_set_address()
+// - RGB, indexed and rectangle frames are gamma corrected during row packing with a table of 256 levels in 8.8 fixed
+//   point, stored with layer_set_gamma(). Until a table is stored the response is linear. Interpolation blends the
+//   corrected levels. Test patterns and bitstream frames are not corrected, and the brightness limiter estimates the
+//   load from the uncorrected values
+// - A rectangle frame (type 4) updates the most recent frame, i.e. the last queued frame or else the presented frame.
+//   Queued palette frames are skipped, as they don't carry pixels. The payload of a rectangle frame is any number of
+//   rectangles: x, y, width and height followed by the red, green and blue planes of the rectangle (row major, 8 bits
+//   per LED). All rectangles are copied onto the most recent frame and the result is queued as a new RGB frame, just
+//   like a received frame. The payload is at most 384 bytes and is padded up to the receive block size, trailing
+//   bytes that don't make up a rectangle header are ignored. A rectangle that doesn't fit the layer drops the whole
+//   frame
+// - A draw frame (type 5) holds render commands, see render.h and render_config.h. The commands are rendered onto a
+//   copy of the most recent frame, which is queued once done. A frame is set aside for this canvas. A draw frame
+//   larger than RENDER_COMMAND_SIZE is dropped like any other frame with a mismatching size
+// - An indexed frame (type 6, 256 bytes) holds the palette index of each LED (row major). The palette has 256 entries
+//   of 8 bit red, green and blue and is expanded during row packing. A palette frame (type 7) updates a range of the
+//   palette: first entry, number of entries (0 for all 256) followed by the red, green and blue of each entry. Palette
+//   frames are queued and applied in order at the start of a scan once due, so palette animations are timed just like
+//   frames and never tear. If the queue is full, the oldest pixel frame is dropped instead, or the oldest palette frame
+//   is applied early if the queue holds nothing else. Until the first palette frame, the palette is a gray ramp.
+//   Indexed frames are never interpolated. Rectangle and draw frames that update an indexed frame expand it with the
+//   current palette, the result is an RGB frame. Indexed frames only save bandwidth, not RAM: an indexed frame still
+//   takes a full frame of the pool and the palette adds 768 bytes
+// - With the CRC check enabled, each frame is followed by a CRC trailer, most significant byte first. The master
+//   calculates the CRC over the header and the frame most significant bit first, with a zero seed and without a final
+//   XOR (e.g. CRC-16/XMODEM for the default polynomial). The DMA CRC engine calculates the CRC over the header, frame
+//   and trailer while receiving, a correct frame leaves a zero remainder. Frames with a mismatching CRC are dropped
+// - In 32 bit SPI mode the DMA empties the enhanced receive FIFO once it is half full, instead of after each byte.
+//   The byte order of the received words is restored by the DMA CRC engine with the CRC check enabled, and in
+//   software otherwise, so the master still sends a plain byte stream. Everything is received in blocks of 8 bytes
+//   in this mode, so the CRC trailer is preceded by zero padding up to 8 bytes. The padding is part of the CRC
+// - The payload DMA is armed in the interrupt of the completed header, as its size and destination depend on the
+//   header. Payload bytes that arrive in the meantime wait in the receive FIFO: 16 bytes in 32 bit SPI mode, a
+//   single byte otherwise. The master has to pause after the header for the remainder, at least 10 us with margin
+//   for the interrupt latency. The payload delay of layer_statistics() holds the longest measured delay to check the
+//   pause against, a pause that is too short overflows the FIFO and the frame is dropped as an overrun
+// - In framed SPI mode SS1 is the frame sync input, the master pulses it (active low) before each word. This keeps
+//   the words aligned to the master, even after a glitch on the clock
+// - The brightness limiter estimates the LED current of each RGB frame when it is received, by summing its 8 bit
+//   values. As rows are multiplexed, the estimate is the average over the rows that are refreshed, so skipping black
+//   rows is taken into account. If it exceeds the budget, all values are scaled down during row packing. The scale
+//   follows the frame at the start of each scan, quickly going down (attack) and slowly going back up (release).
+//   Bitstream frames are not limited, just like gamma correction the master is responsible for those
+// - The remap table holds the source LED of each TLC5940 channel of each row, so row packing takes the orientation
+//   of the board and the wiring of the channels into account without extra work. The orientation and a full
+//   permutation (source LED of each LED, row major) are stored per board by layer_set_remap() and
+//   layer_set_permutation(), the permutation overrides the orientation. LAYER_CHANNEL_ORDER holds the column that is wired to each channel for the PCB revision, the row
+//   wiring is in the row table of layer.c. Bitstream frames are streamed as is and never remapped
+// - With the boot frame enabled, the frame of layer_boot_frame.h is shown from the first scan until the first frame
+//   is presented. Otherwise the cube stays dark until then. See layer_statistics() for the time from boot to the
+//   first latched row
+// - Test patterns are generated while packing the rows, without touching any frame buffer. A pattern is selected with
+//   the test jumper (pulled low at boot, RB2) or with a pattern frame (type 3, 8 bytes: pattern, level and padding).
+//   A pattern frame with pattern 0 returns to the received frames. While a pattern is shown all rows are refreshed,
+//   so the refresh pipeline can be benchmarked without a master streaming frames. The level is the grayscale of the
+//   lit LEDs, the limiter still keeps the current within the budget
+
+#define LAYER_REFRESH_INTERVAL      750     // Refresh interval between layers in us unless stored, initial interval when using the governor
+#define LAYER_REFRESH_INTERVAL_MIN  450     // Shortest refresh interval the governor may pick in us
+#define LAYER_REFRESH_INTERVAL_MAX  1500    // Refresh interval ceiling of the governor in us
+#define LAYER_TTASK_BUDGET          150     // Worst case execution time of a row update in us, keep it above the pack time of layer_statistics()
+#define LAYER_GOVERNOR              1       // Set to 1 to adapt the refresh interval at runtime, set to 0 to use a fixed interval
+#define LAYER_GOVERNOR_MARGIN       150     // Required refresh interval in percent of the measured row time
+#define LAYER_GOVERNOR_HYSTERESIS   50      // Only shorten the refresh interval if it is this much above the required interval in us
+#define LAYER_GOVERNOR_STEP         25      // Refresh interval step in us
+#define LAYER_GOVERNOR_SETTLE       16      // Number of consecutive scans that must allow a shorter refresh interval
+#define LAYER_INTERPOLATION         0       // Set to 1 to blend between the previous and the current frame, set to 0 to disable
+#define LAYER_INTERPOLATION_MAX     250     // Maximum interval between frames that is interpolated in ms
+#define LAYER_QUEUE_DEPTH           2       // Number of frames that can wait for their presentation time
+#define LAYER_CRC                   1       // Set to 1 to check the CRC trailer of each frame, set to 0 to receive frames without trailer
+#define LAYER_CRC_LENGTH            16      // Length of the CRC in bits, either 16 or 32
+#define LAYER_CRC_POLYNOMIAL        0x1021  // CRC polynomial
+#define LAYER_SPI_MODE32            1       // Set to 1 to receive 32 bit words through the enhanced buffer, set to 0 to receive bytes
+#define LAYER_SPI_FRAMED            0       // Set to 1 to use the frame sync pulse on SS1 instead of slave select, set to 0 to disable
+#define LAYER_ROW_DEAD_TIME         400     // Dead-time between switching off the previous row and switching on the next row in ns
+#define LAYER_SKIP_BLACK_ROWS       1       // Set to 1 to skip rows without content, set to 0 to always refresh all rows
+#define LAYER_LIMITER               1       // Set to 1 to limit the brightness of frames exceeding the budget, set to 0 to disable
+#define LAYER_LIMITER_BUDGET        60      // Current budget in percent of a full white row
+#define LAYER_LIMITER_ATTACK        64      // Maximum decrease of the scale per scan in 1/256
+#define LAYER_LIMITER_RELEASE       4       // Maximum increase of the scale per scan in 1/256
+#define LAYER_BOARD_ADDRESS         0       // Address of the board on the shared bus unless stored, 0 to 15
+#define LAYER_REMAP                 LAYER_REMAP_NONE    // Orientation of the board unless stored, see LAYER_REMAP_*
+#define LAYER_CHANNEL_ORDER         { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 } // Column of each TLC5940 channel
+#define LAYER_PATTERN_JUMPER        1       // Set to 1 to show the jumper pattern while the test jumper is fitted, set to 0 to disable
+#define LAYER_JUMPER_PATTERN        LAYER_PATTERN_WALK  // Pattern shown while the test jumper is fitted, see layer_pattern
+#define LAYER_JUMPER_LEVEL          255     // Level of the lit LEDs of the jumper pattern, 1 to 255
+#define LAYER_PATTERN_STEP_TIME     100     // Time in between steps of the moving patterns in ms
+#define LAYER_BOOT_FRAME            1       // Set to 1 to show the boot frame until the first frame, set to 0 to stay dark
 
 #endif	/* LAYER_CONFIG_H */
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef NVM_H
+#define	NVM_H
+
+#include <stdbool.h>
+
+#define NVM_PAGE_SIZE           4096    // Erase unit of the program flash in bytes
+#define NVM_ROW_SIZE            512     // Program unit of the program flash in bytes
+
+#define NVM_PHY_ADDR(virt)      ((unsigned int)(virt) & 0x1FFFFFFFLU)
+#define NVM_KSEG1_ADDR(phy)     ((unsigned int)(phy) | 0xA0000000LU)
+
+// All operations only start the operation, poll nvm_busy() for completion. Page erases and row programs stall the
+// CPU and the interrupts, the stall callback is called with true right before and with false once nvm_busy() sees
+// the operation finished
+bool nvm_busy(void);
+bool nvm_error(void);
+bool nvm_erase_page(unsigned int address);
+bool nvm_write_word(unsigned int address, unsigned int word);
+bool nvm_write_row(unsigned int address, const void* data);
+void nvm_set_stall_callback(void (*callback)(bool stall));
+
+#endif	/* NVM_H */
\ No newline at end of file
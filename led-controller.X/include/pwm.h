@@ -10,9 +10,17 @@ struct pwm_config
     float duty;
 };
 
+struct pwm_statistics
+{
+    unsigned int latency;       // Entry latency of the last period interrupt in ns
+    unsigned int latency_max;   // Longest entry latency of the period interrupt in ns
+    unsigned int resolution;    // Resolution of the latency measurement in ns
+};
+
 void pwm_init(void);
 void pwm_configure(struct pwm_config config);
 void pwm_enable(void);
 void pwm_disable(void);
+struct pwm_statistics pwm_statistics(void);
 
 #endif	/* PWM_H */
\ No newline at end of file
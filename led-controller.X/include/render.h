@@ -0,0 +1,21 @@
+#ifndef RENDER_H
+#define	RENDER_H
+
+#include <stdbool.h>
+
+// Commands start with the command byte followed by its arguments. Coordinates are signed, so text and sprites can
+// start outside the layer. Colors are 8 bit red, green and blue
+enum render_command
+{
+    RENDER_COMMAND_END = 0,         // End of the commands, also used as padding
+    RENDER_COMMAND_CLEAR,           // Fill the layer: red, green, blue
+    RENDER_COMMAND_TEXT,            // Draw a string: x, y, red, green, blue, length, characters
+    RENDER_COMMAND_SCROLL,          // Move the layer: dx, dy, the uncovered LEDs are cleared
+    RENDER_COMMAND_SPRITE,          // Draw a sprite: id, x, y, red, green, blue
+};
+
+bool render_busy(void);
+bool render_ready(void);
+bool render_submit(const unsigned char* commands, unsigned int size);
+
+#endif	/* RENDER_H */
\ No newline at end of file
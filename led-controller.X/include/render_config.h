@@ -0,0 +1,15 @@
+#ifndef RENDER_CONFIG_H
+#define	RENDER_CONFIG_H
+
+// Notes:
+// - Commands are received with a draw frame (type 5, see layer_config.h) and rendered onto the canvas of the layer,
+//   a copy of the most recent frame. Once all commands are rendered, the canvas is queued and presented right away
+// - Rendering is spread over multiple calls of the rtask, each call renders at most a single command or a single
+//   character of a string. A draw frame that arrives while still rendering is dropped
+// - Text uses the 5x7 font of render_font.h (printable ASCII, 6 LEDs per character including the spacing), sprites
+//   are the 8x8 masks of render_sprites.h. Both only set the lit LEDs, everything else is left as is
+// - A ticker only needs a scroll and the character that scrolls in per step, instead of a complete frame
+
+#define RENDER_COMMAND_SIZE         64      // Maximum size of the commands of a single draw frame in bytes
+
+#endif	/* RENDER_CONFIG_H */
\ No newline at end of file
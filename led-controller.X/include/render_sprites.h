@@ -0,0 +1,20 @@
+#ifndef RENDER_SPRITES_H
+#define	RENDER_SPRITES_H
+
+// Sprite sheet of 8x8 masks, a byte per row from top to bottom with the leftmost LED in the most significant bit.
+// The sprite id is the index in the sheet. Only included by render.c
+
+#define RENDER_SPRITE_SIZE          8
+
+static const unsigned char render_sprites[][RENDER_SPRITE_SIZE] =
+{
+    { 0x00, 0x66, 0xff, 0xff, 0xff, 0x7e, 0x3c, 0x18 }, // Heart
+    { 0x3c, 0x42, 0xa5, 0x81, 0xa5, 0x99, 0x42, 0x3c }, // Smiley
+    { 0x08, 0x0c, 0xfe, 0xff, 0xfe, 0x0c, 0x08, 0x00 }, // Arrow right
+    { 0x10, 0x30, 0x7f, 0xff, 0x7f, 0x30, 0x10, 0x00 }, // Arrow left
+    { 0x18, 0x3c, 0x7e, 0xff, 0x18, 0x18, 0x18, 0x18 }, // Arrow up
+    { 0x18, 0x18, 0x18, 0x18, 0xff, 0x7e, 0x3c, 0x18 }, // Arrow down
+    { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }, // Block
+};
+
+#endif	/* RENDER_SPRITES_H */
\ No newline at end of file
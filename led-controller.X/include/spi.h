@@ -65,5 +65,6 @@ void spi_enable(struct spi_module* module);
 void spi_disable(struct spi_module* module);
 bool spi_transmit_mode32(struct spi_module* module, unsigned int* buffer, unsigned int size);
 bool spi_transmit_mode8(struct spi_module* module, unsigned char* buffer, unsigned int size);
+bool spi_receive_overflow(struct spi_module* module);
 
 #endif	/* SPI_H */
\ No newline at end of file
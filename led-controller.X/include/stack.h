@@ -0,0 +1,30 @@
+#ifndef STACK_H
+#define	STACK_H
+
+enum
+{
+    STACK_ISR_DMA0 = 0,
+    STACK_ISR_DMA1,
+    STACK_ISR_DMA2,
+    STACK_ISR_DMA3,
+    STACK_ISR_PWM,
+    
+    __STACK_ISR_COUNT
+};
+
+struct stack_statistics
+{
+    unsigned int size;                                  // Size of the stack in bytes
+    unsigned int used;                                  // High-water mark of the stack in bytes
+    unsigned int worst_case;                            // Worst case derived from the previous build in bytes, 0 until derived
+    unsigned int nesting;                               // Deepest interrupt nesting seen
+    unsigned char isr_nesting[__STACK_ISR_COUNT];       // Deepest interrupt nesting seen per ISR
+};
+
+void stack_paint(void);
+unsigned int stack_high_water_mark(void);
+void stack_isr_enter(int isr); // Call at the very beginning of an ISR
+void stack_isr_exit(void); // Call at the very end of an ISR
+struct stack_statistics stack_statistics(void);
+
+#endif	/* STACK_H */
\ No newline at end of file
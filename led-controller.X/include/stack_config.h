@@ -0,0 +1,18 @@
+#ifndef STACK_CONFIG_H
+#define	STACK_CONFIG_H
+
+// Notes:
+// - The stack is painted with STACK_PAINT_PATTERN at boot, from the stack limit up to the current stack pointer.
+//   The high-water mark is found by scanning from the stack limit for the first word that got overwritten
+// - STACK_SIZE must match the _min_stack_size of the linker script, the linker places the stack after the heap
+// - The high-water mark only covers the call chains and interrupt nesting that actually occurred. The post-build step
+//   tools/stack_usage.py derives the worst case from the frame sizes in the stack usage files (*.su) and the call
+//   graph of the image: the deepest chain from main() plus the deepest ISR of each priority level. It writes the
+//   result to stack_worst_case.h, so the worst case is checked against STACK_SIZE and reported in the statistics
+//   from the next build on. Indirect calls are followed up to 4 levels deep, recursion fails the step
+
+#define STACK_SIZE              0x400       // Stack size in bytes
+#define STACK_PAINT_PATTERN     0xdeadbeef  // Pattern to paint the unused stack with
+#define STACK_PAINT_MARGIN      16          // Bytes below the stack pointer that are left alone while painting
+
+#endif	/* STACK_CONFIG_H */
\ No newline at end of file
@@ -0,0 +1,8 @@
+#ifndef STACK_WORST_CASE_H
+#define	STACK_WORST_CASE_H
+
+// Generated by tools/stack_usage.py after each build, do not edit
+
+#define STACK_WORST_CASE        0x0       // Worst case stack usage in bytes, 0 until derived
+
+#endif	/* STACK_WORST_CASE_H */
\ No newline at end of file
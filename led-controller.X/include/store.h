@@ -0,0 +1,26 @@
+#ifndef STORE_H
+#define	STORE_H
+
+#include <stdbool.h>
+
+enum
+{
+    STORE_KEY_BOARD_ADDRESS = 0,    // Address of the board on the shared bus
+    STORE_KEY_DOT_CORRECTION,       // Dot correction of the drivers in shift order
+    STORE_KEY_GAMMA,                // Gamma table of the layer, 8.8 fixed point level of each 8 bit value
+    STORE_KEY_REFRESH_INTERVAL,     // Refresh interval of the layers in us
+    STORE_KEY_CLOCK_PROFILE,        // GSCLK frequency ceiling of the drivers in Hz
+    STORE_KEY_DEAD_TIME,            // Row dead-time of the layers in ns
+    STORE_KEY_REMAP,                // Orientation of the board, see LAYER_REMAP_*
+    STORE_KEY_PERMUTATION,          // Source LED of each LED, overrides the orientation
+    
+    __STORE_KEY_COUNT
+};
+
+bool store_get(int key, void* value, unsigned int size);
+bool store_set(int key, const void* value, unsigned int size);
+void store_flush(void);
+bool store_busy(void);
+bool store_error(void);
+
+#endif	/* STORE_H */
\ No newline at end of file
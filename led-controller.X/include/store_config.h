@@ -0,0 +1,45 @@
+#ifndef STORE_CONFIG_H
+#define	STORE_CONFIG_H
+
+#include "nvm.h"
+#include "driver.h"
+
+// Notes:
+// - The store is a log of records in a ring of reserved program flash pages. Only one page is active at a time, it
+//   starts with a header (sequence number and magic) followed by the records. A record is a header word (key, size
+//   and CRC-16 of key, size and value) followed by the value, padded to whole words. A newer record of a key
+//   overrides the older ones. Once the active page is full, the current values are compacted into the next page of
+//   the ring, its header is written last. The pages are therefore worn evenly and a page without a complete header
+//   is never picked at boot
+// - All values are loaded into RAM at boot in a single pass over the active page, records with a mismatching CRC
+//   (e.g. an interrupted write) are skipped
+// - Setting a value only changes the RAM copy. Changed values are written once nothing changed for the coalesce
+//   time, or right away with store_flush(). Nothing is written while a firmware update uses the flash
+// - A failed record is written again along with all other values in the next page, a failed compaction starts over
+//   in the same page. After STORE_RETRIES consecutive failures the store keeps the values in RAM only until reset,
+//   see store_error()
+// - Erasing a page stalls the CPU for tens of ms, including the interrupts. The stall callback of nvm.h blanks the
+//   layer meanwhile, so the display goes dark for a moment once the active page is full instead of a single row
+//   lighting up brightly
+// - The pages must not overlap the firmware slots, see firmware_config.h
+// - The board address is set with layer_set_address(), the dot correction with driver_set_dot_correction(), the
+//   gamma table with layer_set_gamma(), the refresh interval with layer_set_refresh_interval(), the row dead-time
+//   with layer_set_dead_time(), the clock profile with driver_set_clock_limit() and the orientation and permutation
+//   with layer_set_remap() and layer_set_permutation(). Each key has a fixed size and a RAM copy, so only add keys that are read back
+
+#define STORE_PAGE_BEGIN            0x1D00E000  // Physical address of the first page
+#define STORE_PAGES                 2           // Number of pages in the ring, at least 2
+#define STORE_COALESCE_TIME         2000        // Time without changes before writing in ms
+#define STORE_RETRIES               3           // Consecutive failed flash operations before writing is given up until reset
+
+// Value size of each key in bytes
+#define STORE_SIZE_BOARD_ADDRESS    1
+#define STORE_SIZE_DOT_CORRECTION   DRIVER_DOT_CORRECTION_SIZE
+#define STORE_SIZE_GAMMA            (256 * sizeof(unsigned short))
+#define STORE_SIZE_REFRESH_INTERVAL sizeof(unsigned int)
+#define STORE_SIZE_CLOCK_PROFILE    sizeof(unsigned int)
+#define STORE_SIZE_DEAD_TIME        sizeof(unsigned int)
+#define STORE_SIZE_REMAP            1
+#define STORE_SIZE_PERMUTATION      256
+
+#endif	/* STORE_CONFIG_H */
\ No newline at end of file
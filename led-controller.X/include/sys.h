@@ -10,16 +10,27 @@
     #error "System peripheral bus clock could not be calculated, please define the _SYS_CLK and _PB_DIV." 
 #endif
 
+#define SYS_CORE_TIMER_CLOCK        ((unsigned long long)(_SYS_CLK / 2))
+#define SYS_CORE_TIMER_TICKS(ns)    ((unsigned int)((SYS_CORE_TIMER_CLOCK * (ns)) / 1000000000LLU))
+#define SYS_CORE_TIMER_NS(ticks)    ((unsigned int)((1000000000LLU * (ticks)) / SYS_CORE_TIMER_CLOCK))
+#define SYS_CORE_TIMER_US(ticks)    ((unsigned int)((1000000LLU * (ticks)) / SYS_CORE_TIMER_CLOCK)) // Any tick count, unlike ns
+
 #define SYS_BONZO_IS_HUNGRY         true
 
 #define sys_goodnight_bonzo()       WDTCONbits.ON = 0
 #define sys_wakeup_bonzo()          WDTCONbits.ON = 1
 #define sys_feed_bonzo()            WDTCONbits.WDTCLR = 1
 
+#define sys_core_timer()            _CP0_GET_COUNT()
+#define sys_core_timer_clear()      _CP0_SET_COUNT(0)
+
 void sys_lock(void);
 void sys_unlock(void);
 void sys_enable_global_interrupt(void);
 void sys_disable_global_interrupt(void);
+unsigned int sys_suspend_global_interrupt(void);
+void sys_resume_global_interrupt(unsigned int status);
 void sys_cpu_early_init(void);
+void sys_core_timer_wait(unsigned int begin, unsigned int ticks);
 
 #endif	/* SYS_H */
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 
 #define TIMER_TICK_INTERVAL     500 // In microseconds
+#define TIMER_TICK_BUDGET       50 // Worst case execution time of a tick including the expired callbacks in microseconds
 #define TIMER_POOL_SIZE         5
 
 struct timer_module;
@@ -3,10 +3,15 @@
 
 #include <stdbool.h>
 
+void tlc5940_early_init(void);
 bool tlc5940_busy(void);
 bool tlc5940_ready(void);
 bool tlc5940_update(void);
+bool tlc5940_update_raw(const unsigned char* buffer, unsigned int size);
 bool tlc5940_set_latch_callback(void (*callback)(void));
 void tlc5940_write_grayscale(unsigned int device, unsigned int channel, unsigned short value);
+void tlc5940_set_cycle_time(unsigned int time);
+bool tlc5940_set_clock_limit(unsigned int frequency);
+bool tlc5940_set_dot_correction(const unsigned char* buffer, unsigned int size);
 
 #endif	/* TLC5940_H */
\ No newline at end of file
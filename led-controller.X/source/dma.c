@@ -1,15 +1,19 @@
 #include "../include/dma.h"
 #include "../include/assert.h"
+#include "../include/interrupt.h"
 #include "../include/register.h"
+#include "../include/stack.h"
 #include "../include/toolbox.h"
 #include <xc.h>
 #include <sys/attribs.h>
 
 #define DMA_PHY_ADDR(virt)              ((int)virt < 0 ? ((int)virt & 0x1FFFFFFFL) : (unsigned int)((unsigned char*)virt + 0x40000000L))
 #define DMA_NUMBER_OF_CHANNELS          (sizeof(dma_channels) / sizeof(dma_channels[0]))
-#define DMA_INTERRUPT_PRIORITY          0x3
          
 #define DMA_DMACON_REG                  DMACON
+#define DMA_DCRCCON_REG                 DCRCCON
+#define DMA_DCRCDATA_REG                DCRCDATA
+#define DMA_DCRCXOR_REG                 DCRCXOR
 
 #define DMA_DMACON_WORD                 BIT(15)
 
@@ -19,12 +23,19 @@
 #define DMA_DCHECON_CHSIRQ_MASK         MASK(0xff, 8)
 #define DMA_DCHECON_AIRQEN_MASK         BIT(3)
 #define DMA_DCHECON_SIRQEN_MASK         BIT(4)
+#define DMA_DCHECON_CFORCE_MASK         BIT(7)
 #define DMA_DCHINT_CHBCIE_MASK          BIT(19)
 #define DMA_DCHINT_CHBCIF_MASK          BIT(3)
 #define DMA_DCHINT_ENABLE_BITS_MASK     MASK(0xffff, 8)
+#define DMA_DCRCCON_CRCCH_MASK          MASK(0x7, 0)
+#define DMA_DCRCCON_CRCEN_MASK          BIT(7)
+#define DMA_DCRCCON_PLEN_MASK           MASK(0x1f, 8)
+#define DMA_DCRCCON_WBO_MASK            BIT(27)
+#define DMA_DCRCCON_BYTO_SWAP32_MASK    BIT(28) // Swap bytes on word boundaries
 
 #define DMA_DCHECON_CHAIRQ_SHIFT        16
 #define DMA_DCHECON_CHSIRQ_SHIFT        8
+#define DMA_DCRCCON_PLEN_SHIFT          8
 
 struct dma_register_map
 {
@@ -62,6 +73,19 @@ struct dma_channel
     bool assigned;
 };
 
+struct dma_mem_request
+{
+    void (*complete)(void);
+    const void* src;
+    void* dst;
+    unsigned short src_size;
+    unsigned short size;
+    unsigned char pattern;
+};
+
+static bool dma_mem_enqueue(struct dma_mem_request request);
+static void dma_mem_start(struct dma_mem_request* request);
+static void dma_mem_transfer_complete(struct dma_channel* channel);
 static void dma_handle_interrupt(struct dma_channel* channel);
 
 static const struct dma_interrupt_map dma_channel_interrupts[] =
@@ -71,35 +95,48 @@ static const struct dma_interrupt_map dma_channel_interrupts[] =
         .iec = atomic_reg_ptr_cast(&IEC2),
         .ipc = atomic_reg_ptr_cast(&IPC10),
         .mask = BIT(8),
-        .priority_mask = MASK(0x7, 18),
-        .priority_shift = 18,
+        .priority_mask = MASK(INT_IPC_MASK, 16),
+        .priority_shift = 16,
     },
     { 
         .ifs = atomic_reg_ptr_cast(&IFS2),
         .iec = atomic_reg_ptr_cast(&IEC2),
         .ipc = atomic_reg_ptr_cast(&IPC10),
         .mask = BIT(9),
-        .priority_mask = MASK(0x7, 26),
-        .priority_shift = 26,
+        .priority_mask = MASK(INT_IPC_MASK, 24),
+        .priority_shift = 24,
     },
     { 
         .ifs = atomic_reg_ptr_cast(&IFS2),
         .iec = atomic_reg_ptr_cast(&IEC2),
         .ipc = atomic_reg_ptr_cast(&IPC11),
         .mask = BIT(10),
-        .priority_mask = MASK(0x7, 2),
-        .priority_shift = 2,
+        .priority_mask = MASK(INT_IPC_MASK, 0),
+        .priority_shift = 0,
     },
     { 
         .ifs = atomic_reg_ptr_cast(&IFS2),
         .iec = atomic_reg_ptr_cast(&IEC2),
         .ipc = atomic_reg_ptr_cast(&IPC11),
         .mask = BIT(11),
-        .priority_mask = MASK(0x7, 10),
-        .priority_shift = 10,
+        .priority_mask = MASK(INT_IPC_MASK, 8),
+        .priority_shift = 8,
     },
 };
 
+static const struct dma_config dma_mem_config =
+{
+    .block_transfer_complete = dma_mem_transfer_complete,
+};
+
+static struct dma_channel* dma_mem_channel = NULL;
+static struct dma_mem_request dma_mem_queue[DMA_MEM_QUEUE_SIZE];
+static unsigned int dma_mem_head = 0;
+static unsigned int dma_mem_count = 0;
+static struct dma_channel* dma_crc_channel = NULL; // The one channel the CRC engine is attached to
+static unsigned int dma_crc_seed = 0;
+static unsigned int dma_crc_mask = 0;
+
 static struct dma_channel dma_channels[] =
 {
     {
@@ -130,7 +167,7 @@ void dma_init(void)
     for(unsigned int i = 0; i < DMA_NUMBER_OF_CHANNELS; ++i)
         atomic_reg_ptr_clr(dma_channels[i].dma_int->iec, dma_channels[i].dma_int->mask);
     
-    // Configure DMA
+    // Configure DMA, the memory service takes a channel at its first request
     DMA_DMACON_REG = DMA_DMACON_WORD;
 }
 
@@ -160,6 +197,12 @@ void dma_destruct(struct dma_channel* channel)
     
     atomic_reg_clr(channel->dma_reg->dchcon, DMA_DCHCON_CHEN_MASK);
     channel->assigned = false;
+    
+    // Detach CRC engine
+    if(channel == dma_crc_channel) {
+        DMA_DCRCCON_REG = 0;
+        dma_crc_channel = NULL;
+    }
 }
 
 void dma_configure(struct dma_channel* channel, struct dma_config config)
@@ -181,6 +224,7 @@ void dma_configure(struct dma_channel* channel, struct dma_config config)
     // Configure events
     dma_configure_start_event(channel, config.start_event);
     dma_configure_abort_event(channel, config.abort_event);
+    dma_configure_crc(channel, config.crc);
     
     // Configure interrupts
     atomic_reg_ptr_clr(dma_int->iec, dma_int->mask);
@@ -190,7 +234,7 @@ void dma_configure(struct dma_channel* channel, struct dma_config config)
     
     if(NULL != config.block_transfer_complete) {
         channel->block_transfer_complete = config.block_transfer_complete;
-        atomic_reg_ptr_set(dma_int->ipc, MASK(DMA_INTERRUPT_PRIORITY, dma_int->priority_shift) & dma_int->priority_mask);
+        atomic_reg_ptr_set(dma_int->ipc, MASK(INT_IPC(INT_DMA_PRIORITY, INT_DMA_SUBPRIORITY), dma_int->priority_shift));
         atomic_reg_set(dma_reg->dchint, DMA_DCHINT_CHBCIE_MASK);
     }
 
@@ -249,6 +293,52 @@ void dma_configure_abort_event(struct dma_channel* channel, struct dma_event eve
     }    
 }
 
+bool dma_configure_crc(struct dma_channel* channel, struct dma_crc crc)
+{
+    ASSERT(NULL != channel);
+    
+    // The CRC engine can only be attached to a single channel
+    if(NULL != dma_crc_channel && channel != dma_crc_channel)
+        return !crc.enable;
+    
+    DMA_DCRCCON_REG = 0;
+    dma_crc_channel = NULL;
+    if(crc.enable) {
+        ASSERT(crc.length > 0 && crc.length <= 32);
+        dma_crc_channel = channel;
+        dma_crc_seed = crc.seed;
+        dma_crc_mask = crc.length < 32 ? BIT(crc.length) - 1 : 0xffffffff;
+        
+        // Calculate the CRC in the background, the transferred data is left untouched
+        DMA_DCRCXOR_REG = crc.polynomial;
+        DMA_DCRCDATA_REG = crc.seed;
+        DMA_DCRCCON_REG = (MASK_SHIFT((crc.length - 1), DMA_DCRCCON_PLEN_SHIFT) & DMA_DCRCCON_PLEN_MASK)
+            | ((unsigned int)(channel - dma_channels) & DMA_DCRCCON_CRCCH_MASK)
+            | DMA_DCRCCON_CRCEN_MASK;
+        
+        // Unless the bytes must be swapped, then the swapped bytes are written instead
+        if(crc.swap_bytes)
+            DMA_DCRCCON_REG |= DMA_DCRCCON_BYTO_SWAP32_MASK | DMA_DCRCCON_WBO_MASK;
+    }
+    return true;
+}
+
+void dma_crc_reset(struct dma_channel* channel)
+{
+    ASSERT(channel == dma_crc_channel);
+    (void)(channel);
+    
+    DMA_DCRCDATA_REG = dma_crc_seed;
+}
+
+unsigned int dma_crc_result(struct dma_channel* channel)
+{
+    ASSERT(channel == dma_crc_channel);
+    (void)(channel);
+    
+    return DMA_DCRCDATA_REG & dma_crc_mask;
+}
+
 void dma_enable_transfer(struct dma_channel* channel)
 {
     ASSERT(NULL != channel);
@@ -256,6 +346,40 @@ void dma_enable_transfer(struct dma_channel* channel)
     atomic_reg_set(channel->dma_reg->dchcon, DMA_DCHCON_CHEN_MASK);
 }
 
+bool dma_mem_fill(void* dst, unsigned char value, unsigned short size, void (*complete)(void))
+{
+    struct dma_mem_request request =
+    {
+        .complete = complete,
+        .src = NULL, // Source is the pattern of the queued request
+        .dst = dst,
+        .src_size = sizeof(request.pattern),
+        .size = size,
+        .pattern = value,
+    };
+    
+    return dma_mem_enqueue(request);
+}
+
+bool dma_mem_copy(void* dst, const void* src, unsigned short size, void (*complete)(void))
+{
+    struct dma_mem_request request =
+    {
+        .complete = complete,
+        .src = src,
+        .dst = dst,
+        .src_size = size,
+        .size = size,
+    };
+    
+    return dma_mem_enqueue(request);
+}
+
+bool dma_mem_busy(void)
+{
+    return dma_mem_count > 0;
+}
+
 bool dma_busy(struct dma_channel* channel)
 {
     ASSERT(NULL != channel);
@@ -268,36 +392,101 @@ bool dma_ready(struct dma_channel* channel)
     return !dma_busy(channel);
 }
 
+static bool dma_mem_enqueue(struct dma_mem_request request)
+{
+    ASSERT(NULL != request.dst);
+    const struct dma_interrupt_map* dma_int;
+    bool result = false;
+    
+    if(0 == request.size)
+        return false;
+    
+    // The peripherals construct their channels at init, the memory service only gets a channel that is left over
+    if(NULL == dma_mem_channel)
+        dma_mem_channel = dma_construct(dma_mem_config);
+    if(NULL == dma_mem_channel)
+        return false;
+    dma_int = dma_mem_channel->dma_int;
+    
+    // Keep the completion interrupt out while modifying the queue
+    atomic_reg_ptr_clr(dma_int->iec, dma_int->mask);
+    if(dma_mem_count < DMA_MEM_QUEUE_SIZE) {
+        dma_mem_queue[(dma_mem_head + dma_mem_count) % DMA_MEM_QUEUE_SIZE] = request;
+        if(0 == dma_mem_count++)
+            dma_mem_start(&dma_mem_queue[dma_mem_head]);
+        result = true;
+    }
+    atomic_reg_ptr_set(dma_int->iec, dma_int->mask);
+    
+    return result;
+}
+
+static void dma_mem_start(struct dma_mem_request* request)
+{
+    const void* src = NULL != request->src ? request->src : &request->pattern;
+    
+    // Transfer the whole request in a single cell, started by software
+    dma_configure_src(dma_mem_channel, src, request->src_size);
+    dma_configure_dst(dma_mem_channel, request->dst, request->size);
+    dma_configure_cell(dma_mem_channel, request->size);
+    dma_enable_transfer(dma_mem_channel);
+    atomic_reg_set(dma_mem_channel->dma_reg->dchecon, DMA_DCHECON_CFORCE_MASK);
+}
+
+static void dma_mem_transfer_complete(struct dma_channel* channel)
+{
+    void (*complete)(void) = dma_mem_queue[dma_mem_head].complete;
+    (void)(channel);
+    
+    // Start the next request before notifying, the completed request is free from now on
+    dma_mem_head = (dma_mem_head + 1) % DMA_MEM_QUEUE_SIZE;
+    if(--dma_mem_count > 0)
+        dma_mem_start(&dma_mem_queue[dma_mem_head]);
+    
+    if(NULL != complete)
+        complete();
+}
+
 static void dma_handle_interrupt(struct dma_channel* channel)
 {
     unsigned int int_flags = atomic_reg_value(channel->dma_reg->dchint);
     
-    if(int_flags & DMA_DCHINT_CHBCIF_MASK) {
+    // Acknowledge before the callback, as it might start a new transfer
+    atomic_reg_clr(channel->dma_reg->dchint, int_flags & DMA_DCHINT_CHBCIF_MASK);
+    atomic_reg_ptr_clr(channel->dma_int->ifs, channel->dma_int->mask);
+    
+    if(int_flags & DMA_DCHINT_CHBCIF_MASK)
         channel->block_transfer_complete(channel);
-        atomic_reg_clr(channel->dma_reg->dchint, DMA_DCHINT_CHBCIF_MASK);
-    }
 }
 
-void __ISR(_DMA_0_VECTOR, IPL7AUTO) dma_interrupt0(void)
+void __ISR(_DMA_0_VECTOR, INT_IPL(INT_DMA_PRIORITY)) dma_interrupt0(void)
 {
     static struct dma_channel *channel = &dma_channels[0];
+    stack_isr_enter(STACK_ISR_DMA0);
     dma_handle_interrupt(channel);
+    stack_isr_exit();
 }
 
-void __ISR(_DMA_1_VECTOR, IPL7AUTO) dma_interrupt1(void)
+void __ISR(_DMA_1_VECTOR, INT_IPL(INT_DMA_PRIORITY)) dma_interrupt1(void)
 {
     static struct dma_channel *channel = &dma_channels[1];
+    stack_isr_enter(STACK_ISR_DMA1);
     dma_handle_interrupt(channel);
+    stack_isr_exit();
 }
 
-void __ISR(_DMA_2_VECTOR, IPL7AUTO) dma_interrupt2(void)
+void __ISR(_DMA_2_VECTOR, INT_IPL(INT_DMA_PRIORITY)) dma_interrupt2(void)
 {
     static struct dma_channel *channel = &dma_channels[2];
+    stack_isr_enter(STACK_ISR_DMA2);
     dma_handle_interrupt(channel);
+    stack_isr_exit();
 }
 
-void __ISR(_DMA_3_VECTOR, IPL7AUTO) dma_interrupt3(void)
+void __ISR(_DMA_3_VECTOR, INT_IPL(INT_DMA_PRIORITY)) dma_interrupt3(void)
 {
     static struct dma_channel *channel = &dma_channels[3];
+    stack_isr_enter(STACK_ISR_DMA3);
     dma_handle_interrupt(channel);
+    stack_isr_exit();
 }
\ No newline at end of file
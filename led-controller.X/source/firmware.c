@@ -0,0 +1,457 @@
+#include "../include/firmware.h"
+#include "../include/firmware_config.h"
+#include "../include/nvm.h"
+#include "../include/uart.h"
+#include "../include/sys.h"
+#include "../include/kernel_task.h"
+#include "../include/assert.h"
+#include <stddef.h>
+#include <string.h>
+
+#if !defined(FIRMWARE_UPDATE)
+    #error "Firmware update is not specified, please define 'FIRMWARE_UPDATE'"
+#elif !defined(FIRMWARE_SLOT_A) || !defined(FIRMWARE_SLOT_B)
+    #error "Firmware slots not specified, please define 'FIRMWARE_SLOT_A' and 'FIRMWARE_SLOT_B'"
+#elif !defined(FIRMWARE_SLOT_SIZE) || (FIRMWARE_SLOT_SIZE % NVM_PAGE_SIZE)
+    #error "Firmware slot size must be a multiple of the page size, please define 'FIRMWARE_SLOT_SIZE'"
+#elif !defined(FIRMWARE_BOOT_ATTEMPTS) || (FIRMWARE_BOOT_ATTEMPTS < 1)
+    #error "Firmware boot attempts must be at least 1, please define 'FIRMWARE_BOOT_ATTEMPTS'"
+#elif !defined(FIRMWARE_UART)
+    #error "Firmware UART update is not specified, please define 'FIRMWARE_UART'"
+#elif (FIRMWARE_UART == 1) && (FIRMWARE_UPDATE != 1)
+    #error "Firmware UART update requires 'FIRMWARE_UPDATE'"
+#elif !defined(FIRMWARE_UART_TIMEOUT)
+    #error "Firmware UART timeout is not specified, please define 'FIRMWARE_UART_TIMEOUT'"
+#endif
+
+#if (FIRMWARE_UPDATE == 1)
+
+#define FIRMWARE_NUM_OF_SLOTS       2
+#define FIRMWARE_ROW_BUFFERS        2 // Receive the next row while programming the previous row
+#define FIRMWARE_INFO_OFFSET        (FIRMWARE_SLOT_SIZE - NVM_ROW_SIZE) // Slot info lives in the last row
+#define FIRMWARE_IMAGE_MAX_SIZE     FIRMWARE_INFO_OFFSET
+#define FIRMWARE_INFO_COMMIT_WORDS  4 // Version, size, CRC and magic, in this order
+#define FIRMWARE_MAGIC              0x4c454443 // "LEDC"
+#define FIRMWARE_ERASED             0xffffffff
+#define FIRMWARE_CRC_SEED           0xffffffff
+#define FIRMWARE_CRC_POLYNOMIAL     0xedb88320
+
+#define FIRMWARE_UART_UPDATE        'U'
+#define FIRMWARE_UART_ACK           'K'
+#define FIRMWARE_UART_DONE          'D'
+#define FIRMWARE_UART_ERROR         'E'
+#define FIRMWARE_UART_TIMEOUT_TICKS SYS_CORE_TIMER_TICKS(FIRMWARE_UART_TIMEOUT * 1000000LLU)
+
+#define firmware_slot_info(slot)    ((const volatile struct firmware_slot_info*)NVM_KSEG1_ADDR(firmware_slots[slot] + FIRMWARE_INFO_OFFSET))
+#define firmware_slot_word(slot)    (*(const volatile unsigned int*)NVM_KSEG1_ADDR(firmware_slots[slot]))
+#define firmware_uart_header_word(i) ((unsigned int) firmware_uart_header[4 * (i)] \
+                                    | ((unsigned int) firmware_uart_header[4 * (i) + 1] << 8) \
+                                    | ((unsigned int) firmware_uart_header[4 * (i) + 2] << 16) \
+                                    | ((unsigned int) firmware_uart_header[4 * (i) + 3] << 24))
+
+struct firmware_slot_info
+{
+    unsigned int version;                           // Version of the image
+    unsigned int size;                              // Size of the image in bytes
+    unsigned int crc;                               // CRC of the image
+    unsigned int magic;                             // FIRMWARE_MAGIC once the image is verified, written last
+    unsigned int attempts[FIRMWARE_BOOT_ATTEMPTS];  // Each boot attempt clears the next word
+    unsigned int confirmed;                         // Cleared by the application once it is up and running
+};
+
+enum firmware_state
+{
+    FIRMWARE_IDLE = 0,
+    FIRMWARE_ERASE,
+    FIRMWARE_PROGRAM,
+    FIRMWARE_VERIFY,
+    FIRMWARE_COMMIT,
+    FIRMWARE_DONE,
+    FIRMWARE_ERROR,
+};
+
+enum firmware_uart_state
+{
+    FIRMWARE_UART_COMMAND = 0,
+    FIRMWARE_UART_HEADER,
+    FIRMWARE_UART_ERASE,
+    FIRMWARE_UART_IMAGE,
+    FIRMWARE_UART_RESULT,
+};
+
+static bool firmware_slot_bootable(int slot);
+static unsigned int firmware_crc32(unsigned int crc, const volatile unsigned char* data, unsigned int size);
+static unsigned int firmware_update_space(void);
+#if (FIRMWARE_UART == 1)
+static void firmware_uart_execute(void);
+#endif
+
+static int firmware_rtask_init(void);
+static void firmware_rtask_execute(void);
+KERN_QUICK_RTASK(firmware, firmware_rtask_init, firmware_rtask_execute);
+
+static const unsigned int firmware_slots[FIRMWARE_NUM_OF_SLOTS] = { FIRMWARE_SLOT_A, FIRMWARE_SLOT_B };
+
+static unsigned char firmware_rows[FIRMWARE_ROW_BUFFERS][NVM_ROW_SIZE] __attribute__((aligned(4)));
+static enum firmware_state firmware_state = FIRMWARE_IDLE;
+static struct firmware_slot_info firmware_info; // Slot info of the update
+static unsigned int firmware_slot = 0; // Physical address of the slot that is updated
+static unsigned int firmware_address = 0; // Next address to erase, program or verify
+static unsigned int firmware_received = 0; // Number of image bytes received
+static unsigned int firmware_fill = 0; // Number of bytes in the row buffer that is filled
+static unsigned int firmware_pending = 0; // Number of full row buffers, including the one being programmed
+static unsigned int firmware_row_index = 0; // Row buffer that is programmed next
+static unsigned int firmware_programmed = 0; // Number of rows programmed
+static bool firmware_programming = false;
+static unsigned int firmware_checksum = 0;
+static unsigned int firmware_commit_index = 0;
+
+#if (FIRMWARE_UART == 1)
+static enum firmware_uart_state firmware_uart_state = FIRMWARE_UART_COMMAND;
+static unsigned char firmware_uart_header[3 * sizeof(unsigned int)];
+static unsigned int firmware_uart_count = 0;
+static unsigned int firmware_uart_acked = 0; // Number of programmed rows that were acknowledged
+static unsigned int firmware_uart_activity = 0; // Core timer value of the last progress
+#endif
+
+int firmware_running_slot(void)
+{
+    unsigned int address = NVM_PHY_ADDR(&firmware_running_slot);
+    
+    for(int i = 0; i < FIRMWARE_NUM_OF_SLOTS; ++i) {
+        if(address >= firmware_slots[i] && address < firmware_slots[i] + FIRMWARE_SLOT_SIZE)
+            return i;
+    }
+    return FIRMWARE_SLOT_NONE;
+}
+
+int firmware_boot_slot(void)
+{
+    int slot = FIRMWARE_SLOT_NONE;
+    
+    // Boot the newest bootable slot
+    for(int i = 0; i < FIRMWARE_NUM_OF_SLOTS; ++i) {
+        if(!firmware_slot_bootable(i))
+            continue;
+        if(FIRMWARE_SLOT_NONE == slot || firmware_slot_info(i)->version > firmware_slot_info(slot)->version)
+            slot = i;
+    }
+    
+    // The factory image in slot A isn't written by an update and has no slot info, it is the last resort
+    if(FIRMWARE_SLOT_NONE == slot && FIRMWARE_ERASED != firmware_slot_word(0))
+        slot = 0;
+    return slot;
+}
+
+void firmware_boot_attempt(int slot)
+{
+    const volatile struct firmware_slot_info* info;
+    
+    ASSERT(slot >= 0 && slot < FIRMWARE_NUM_OF_SLOTS);
+    
+    // A confirmed slot doesn't count attempts anymore
+    info = firmware_slot_info(slot);
+    if(FIRMWARE_ERASED != info->confirmed)
+        return;
+    
+    for(int i = 0; i < FIRMWARE_BOOT_ATTEMPTS; ++i) {
+        if(FIRMWARE_ERASED == info->attempts[i]) {
+            while(!nvm_write_word((unsigned int)&info->attempts[i], 0));
+            while(nvm_busy());
+            break;
+        }
+    }
+}
+
+void firmware_confirm(void)
+{
+    int slot = firmware_running_slot();
+    const volatile struct firmware_slot_info* info;
+    
+    if(FIRMWARE_SLOT_NONE == slot)
+        return;
+    
+    // Only an image that was written by an update carries a slot info, the factory image is booted as last resort
+    info = firmware_slot_info(slot);
+    if(FIRMWARE_MAGIC == info->magic && FIRMWARE_ERASED == info->confirmed) {
+        while(!nvm_write_word((unsigned int)&info->confirmed, 0));
+        while(nvm_busy());
+    }
+}
+
+bool firmware_update_begin(unsigned int size, unsigned int crc, unsigned int version)
+{
+    int slot = firmware_running_slot();
+    
+    if(FIRMWARE_ERASE <= firmware_state && FIRMWARE_COMMIT >= firmware_state)
+        return false;
+    if(0 == size || size > FIRMWARE_IMAGE_MAX_SIZE)
+        return false;
+    
+    // Never overwrite the running slot
+    firmware_slot = firmware_slots[FIRMWARE_SLOT_NONE == slot ? 0 : (slot + 1) % FIRMWARE_NUM_OF_SLOTS];
+    firmware_info.version = version;
+    firmware_info.size = size;
+    firmware_info.crc = crc;
+    firmware_info.magic = FIRMWARE_MAGIC;
+    
+    firmware_address = firmware_slot;
+    firmware_received = 0;
+    firmware_fill = 0;
+    firmware_pending = 0;
+    firmware_row_index = 0;
+    firmware_programmed = 0;
+    firmware_programming = false;
+    firmware_state = FIRMWARE_ERASE;
+    return true;
+}
+
+void firmware_update_abort(void)
+{
+    // The slot info is written last, so an aborted update never leaves a bootable slot behind
+    if(FIRMWARE_STATUS_BUSY == firmware_update_status())
+        firmware_state = FIRMWARE_ERROR;
+}
+
+unsigned int firmware_update_write(const unsigned char* data, unsigned int size)
+{
+    unsigned char* row;
+    unsigned int accepted = 0;
+    unsigned int count;
+    
+    ASSERT(NULL != data);
+    
+    // Accept data while erasing as well, it is programmed once the slot is erased
+    if(FIRMWARE_ERASE != firmware_state && FIRMWARE_PROGRAM != firmware_state)
+        return 0;
+    
+    while(accepted < size && firmware_update_space() > 0) {
+        row = firmware_rows[(firmware_row_index + firmware_pending) % FIRMWARE_ROW_BUFFERS];
+        count = size - accepted;
+        if(count > NVM_ROW_SIZE - firmware_fill)
+            count = NVM_ROW_SIZE - firmware_fill;
+        if(count > firmware_info.size - firmware_received)
+            count = firmware_info.size - firmware_received;
+        
+        memcpy(&row[firmware_fill], &data[accepted], count);
+        firmware_fill += count;
+        firmware_received += count;
+        accepted += count;
+        
+        // Row is complete, the last row is padded with erased flash
+        if(NVM_ROW_SIZE == firmware_fill || firmware_info.size == firmware_received) {
+            memset(&row[firmware_fill], 0xff, NVM_ROW_SIZE - firmware_fill);
+            firmware_fill = 0;
+            firmware_pending++;
+        }
+    }
+    return accepted;
+}
+
+enum firmware_status firmware_update_status(void)
+{
+    switch(firmware_state) {
+        case FIRMWARE_IDLE:     return FIRMWARE_STATUS_IDLE;
+        case FIRMWARE_DONE:     return FIRMWARE_STATUS_DONE;
+        case FIRMWARE_ERROR:    return FIRMWARE_STATUS_ERROR;
+        default:                return FIRMWARE_STATUS_BUSY;
+    }
+}
+
+static bool firmware_slot_bootable(int slot)
+{
+    const volatile struct firmware_slot_info* info = firmware_slot_info(slot);
+    
+    if(FIRMWARE_MAGIC != info->magic)
+        return false;
+    if(FIRMWARE_ERASED != info->confirmed)
+        return true;
+    
+    // Not confirmed yet, only bootable while there are attempts left
+    return FIRMWARE_ERASED == info->attempts[FIRMWARE_BOOT_ATTEMPTS - 1];
+}
+
+static unsigned int firmware_crc32(unsigned int crc, const volatile unsigned char* data, unsigned int size)
+{
+    while(size-- > 0) {
+        crc ^= *data++;
+        for(unsigned int i = 0; i < 8; ++i)
+            crc = (crc >> 1) ^ (FIRMWARE_CRC_POLYNOMIAL & -(crc & 1));
+    }
+    return crc;
+}
+
+static unsigned int firmware_update_space(void)
+{
+    if(firmware_received >= firmware_info.size || firmware_pending >= FIRMWARE_ROW_BUFFERS)
+        return 0;
+    return NVM_ROW_SIZE - firmware_fill;
+}
+
+#if (FIRMWARE_UART == 1)
+static void firmware_uart_execute(void)
+{
+    unsigned char data;
+    
+    // Give up on a receive error (e.g. an overrun) or once the master stopped sending, so the flash is released again
+    if(FIRMWARE_UART_COMMAND != firmware_uart_state) {
+        if(UART_STATUS_ERROR == uart_current_status() 
+                || sys_core_timer() - firmware_uart_activity > FIRMWARE_UART_TIMEOUT_TICKS) {
+            firmware_update_abort();
+            uart_error_reset();
+            firmware_uart_state = FIRMWARE_UART_COMMAND;
+            return;
+        }
+    } else if(UART_STATUS_ERROR == uart_current_status())
+        uart_error_reset();
+    
+    switch(firmware_uart_state) {
+        default:
+        case FIRMWARE_UART_COMMAND:
+            if(uart_read_available() && FIRMWARE_UART_UPDATE == uart_read()) {
+                firmware_uart_count = 0;
+                firmware_uart_activity = sys_core_timer();
+                firmware_uart_state = FIRMWARE_UART_HEADER;
+            }
+            break;
+        case FIRMWARE_UART_HEADER:
+            while(uart_read_available() && firmware_uart_count < sizeof(firmware_uart_header)) {
+                firmware_uart_header[firmware_uart_count++] = uart_read();
+                firmware_uart_activity = sys_core_timer();
+            }
+            if(firmware_uart_count < sizeof(firmware_uart_header))
+                break;
+            
+            // Size, CRC and version, little endian
+            if(firmware_update_begin(
+                    firmware_uart_header_word(0),
+                    firmware_uart_header_word(1),
+                    firmware_uart_header_word(2)))
+                firmware_uart_state = FIRMWARE_UART_ERASE;
+            else {
+                uart_transmit(FIRMWARE_UART_ERROR);
+                firmware_uart_state = FIRMWARE_UART_COMMAND;
+            }
+            break;
+        case FIRMWARE_UART_ERASE:
+            // Erasing stalls the CPU for a while, so only let the master start once erased
+            firmware_uart_activity = sys_core_timer();
+            if(FIRMWARE_ERASE != firmware_state) {
+                uart_transmit(FIRMWARE_STATUS_ERROR == firmware_update_status() ? FIRMWARE_UART_ERROR : FIRMWARE_UART_ACK);
+                firmware_uart_acked = 0;
+                firmware_uart_state = FIRMWARE_STATUS_ERROR == firmware_update_status() ? FIRMWARE_UART_COMMAND : FIRMWARE_UART_IMAGE;
+            }
+            break;
+        case FIRMWARE_UART_IMAGE:
+            while(firmware_update_space() > 0 && uart_read_available()) {
+                data = uart_read();
+                firmware_update_write(&data, 1);
+                firmware_uart_activity = sys_core_timer();
+            }
+            
+            // Programming a row stalls the CPU and the UART isn't serviced meanwhile, so a block is only
+            // acknowledged once programmed. The master doesn't send the next block until then
+            while(firmware_uart_acked < firmware_programmed) {
+                uart_transmit(FIRMWARE_UART_ACK);
+                firmware_uart_acked++;
+                firmware_uart_activity = sys_core_timer();
+            }
+            if(FIRMWARE_STATUS_BUSY != firmware_update_status())
+                firmware_uart_state = FIRMWARE_UART_RESULT;
+            break;
+        case FIRMWARE_UART_RESULT:
+            firmware_uart_activity = sys_core_timer();
+            if(FIRMWARE_STATUS_BUSY != firmware_update_status()) {
+                uart_transmit(FIRMWARE_STATUS_DONE == firmware_update_status() ? FIRMWARE_UART_DONE : FIRMWARE_UART_ERROR);
+                firmware_uart_state = FIRMWARE_UART_COMMAND;
+            }
+            break;
+    }
+}
+#endif
+
+static int firmware_rtask_init(void)
+{
+    return KERN_INIT_SUCCCES;
+}
+
+static void firmware_rtask_execute(void)
+{
+    unsigned int count;
+    
+#if (FIRMWARE_UART == 1)
+    firmware_uart_execute();
+#endif
+    
+    switch(firmware_state) {
+        default:
+        case FIRMWARE_IDLE:
+        case FIRMWARE_DONE:
+        case FIRMWARE_ERROR:
+            break;
+        case FIRMWARE_ERASE:
+            if(nvm_busy())
+                break;
+            if(nvm_error())
+                firmware_state = FIRMWARE_ERROR;
+            else if(firmware_address < firmware_slot + FIRMWARE_SLOT_SIZE) {
+                nvm_erase_page(firmware_address);
+                firmware_address += NVM_PAGE_SIZE;
+            } else {
+                firmware_address = firmware_slot;
+                firmware_state = FIRMWARE_PROGRAM;
+            }
+            break;
+        case FIRMWARE_PROGRAM:
+            if(nvm_busy())
+                break;
+            
+            // Row is programmed, its buffer can be filled again
+            if(firmware_programming) {
+                firmware_programming = false;
+                if(nvm_error()) {
+                    firmware_state = FIRMWARE_ERROR;
+                    break;
+                }
+                firmware_row_index = (firmware_row_index + 1) % FIRMWARE_ROW_BUFFERS;
+                firmware_pending--;
+                firmware_programmed++;
+                firmware_address += NVM_ROW_SIZE;
+            }
+            
+            if(firmware_pending > 0)
+                firmware_programming = nvm_write_row(firmware_address, firmware_rows[firmware_row_index]);
+            else if(firmware_received == firmware_info.size) {
+                firmware_address = firmware_slot;
+                firmware_checksum = FIRMWARE_CRC_SEED;
+                firmware_state = FIRMWARE_VERIFY;
+            }
+            break;
+        case FIRMWARE_VERIFY:
+            // Read back a row at a time, bypassing the cache
+            count = firmware_slot + firmware_info.size - firmware_address;
+            if(count > NVM_ROW_SIZE)
+                count = NVM_ROW_SIZE;
+            firmware_checksum = firmware_crc32(firmware_checksum, (const volatile unsigned char*)NVM_KSEG1_ADDR(firmware_address), count);
+            firmware_address += count;
+            
+            if(firmware_address == firmware_slot + firmware_info.size) {
+                firmware_commit_index = 0;
+                firmware_state = (firmware_checksum ^ FIRMWARE_CRC_SEED) == firmware_info.crc ? FIRMWARE_COMMIT : FIRMWARE_ERROR;
+            }
+            break;
+        case FIRMWARE_COMMIT:
+            if(nvm_busy())
+                break;
+            if(nvm_error())
+                firmware_state = FIRMWARE_ERROR;
+            else if(firmware_commit_index < FIRMWARE_INFO_COMMIT_WORDS) {
+                nvm_write_word(firmware_slot + FIRMWARE_INFO_OFFSET + firmware_commit_index * sizeof(unsigned int),
+                        ((const unsigned int*)&firmware_info)[firmware_commit_index]);
+                firmware_commit_index++;
+            } else
+                firmware_state = FIRMWARE_DONE;
+            break;
+    }
+}
+#endif
\ No newline at end of file
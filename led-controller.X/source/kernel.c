@@ -1,6 +1,7 @@
 #include "../include/kernel.h"
 #include "../include/kernel_task.h"
 #include "../include/kernel_config.h"
+#include "../include/sys.h"
 #include <xc.h>
 #include <stddef.h>
 
@@ -16,9 +17,14 @@
     #error "Timer enable bit from config register not specified, please define 'KERN_TMR_EN_BIT'"
 #elif !defined(KERN_TMR_CLKIN_FREQ)
     #error "System tick could not be calculated, please define 'KERN_TMR_CLKIN_FREQ'"
+#elif !defined(KERN_SCHEDULE_TABLE)
+    #error "Schedule table is not specified, please define 'KERN_SCHEDULE_TABLE'"
+#elif (KERN_SCHEDULE_TABLE == 1) && (!defined(KERN_SCHEDULE_SLOTS) || !defined(KERN_SCHEDULE_ENTRIES))
+    #error "Schedule table size not specified, please define 'KERN_SCHEDULE_SLOTS' and 'KERN_SCHEDULE_ENTRIES'"
 #endif
 
 #define KERNEL_SYSTEM_TICK ((1000000.0F / KERN_TMR_CLKIN_FREQ) * KERN_TMR_PRESCALER)
+#define KERNEL_TIMER_MAX ((timer_size_t)~0)
 
 #define kernel_restore_rtask_iterator()                                 \
             kernel_rtask_iterator = &__kernel_rstack_begin
@@ -39,8 +45,16 @@ static void kernel_init_configure_ttask(void);
 static void kernel_init_configure_rtask(void);
 static void kernel_init_ttask_call_sequence(void);
 static void kernel_init_task_init(void);
+static void kernel_init_ttask_phase(void);
 inline static void __attribute__((always_inline)) kernel_execute_ttask_rtask(void);
 inline static void __attribute__((always_inline)) kernel_execute_ttask(void);
+static void kernel_execute_ttask_list(void);
+#if (KERN_SCHEDULE_TABLE == 1)
+static void kernel_execute_ttask_table(void);
+static void kernel_schedule_update(void);
+static bool kernel_schedule_build(void);
+#endif
+static unsigned int kernel_gcd(unsigned int a, unsigned int b);
 inline static void __attribute__((always_inline)) kernel_execute_rtask(void);
 inline static void __attribute__((always_inline)) kernel_execute_no_task(void);
 static int kernel_compute_sys_ticks(int time, int unit);
@@ -60,6 +74,20 @@ static const struct kernel_ttask* kernel_ttask_sorted_begin = NULL;
 static const struct kernel_ttask* kernel_ttask_sorted_end = NULL;
 
 static void (*kernel_exec_func)(void) = NULL;
+static void (*kernel_ttask_exec_func)(void) = kernel_execute_ttask_list;
+
+#if (KERN_SCHEDULE_TABLE == 1)
+static const struct kernel_ttask* kernel_schedule_entries[KERN_SCHEDULE_ENTRIES]; // Released ttasks of all minor frames
+static unsigned char kernel_schedule_slots[KERN_SCHEDULE_SLOTS + 1]; // First entry of each minor frame
+static unsigned int kernel_schedule_size = 0; // Number of minor frames in the major frame
+static unsigned int kernel_schedule_slot = 0;
+static unsigned int kernel_schedule_minor = 0; // Minor frame in ticks
+static bool kernel_schedule_dirty = false;
+#endif
+static unsigned int kernel_schedule_overruns = 0;
+static unsigned int kernel_releases = 0;
+static unsigned int kernel_coincident_releases = 0;
+static timer_size_t kernel_release_lateness = 0;
 
 static timer_size_t elapsed_ticks = 0;
 static timer_size_t previous_ticks = 0;
@@ -69,7 +97,12 @@ void kernel_init(void)
     kernel_init_configure_ttask();
     kernel_init_configure_rtask();
     kernel_init_ttask_call_sequence();
+    kernel_init_ttask_phase();
     kernel_init_task_init();
+#if (KERN_SCHEDULE_TABLE == 1)
+    if(kernel_ttask_size() != 0)
+        kernel_schedule_update();
+#endif
     
     if(kernel_rtask_size() != 0 && kernel_ttask_size() != 0)
         kernel_exec_func = kernel_execute_ttask_rtask;
@@ -93,6 +126,28 @@ void kernel_execute(void)
     (*kernel_exec_func)();
 }
 
+struct kernel_statistics kernel_statistics(void)
+{
+    struct kernel_statistics statistics =
+    {
+        .schedule_table = false,
+        .overruns = kernel_schedule_overruns,
+        .releases = kernel_releases,
+        .coincident = kernel_coincident_releases,
+        .lateness = kernel_release_lateness * KERNEL_SYSTEM_TICK,
+        .stack = stack_statistics(),
+    };
+    
+#if (KERN_SCHEDULE_TABLE == 1)
+    if(kernel_ttask_exec_func == kernel_execute_ttask_table) {
+        statistics.schedule_table = true;
+        statistics.minor_frame = kernel_schedule_minor * KERNEL_SYSTEM_TICK;
+        statistics.major_frame = kernel_schedule_minor * kernel_schedule_size * KERNEL_SYSTEM_TICK;
+    }
+#endif
+    return statistics;
+}
+
 void kernel_ttask_set_priority(struct kernel_ttask_param* const ttask_param, int priority)
 {
     if(NULL != ttask_param) {
@@ -104,8 +159,60 @@ void kernel_ttask_set_priority(struct kernel_ttask_param* const ttask_param, int
 
 void kernel_ttask_set_interval(struct kernel_ttask_param* const ttask_param, int time, int unit)
 {
-    if(NULL != ttask_param)
+    if(NULL != ttask_param) {
         ttask_param->interval = kernel_compute_sys_ticks(time, unit);
+#if (KERN_SCHEDULE_TABLE == 1)
+        kernel_schedule_dirty = true;
+#endif
+    }
+}
+
+void kernel_ttask_set_phase(struct kernel_ttask_param* const ttask_param, int time, int unit)
+{
+    // Only effective before init
+    if(NULL != ttask_param && !ttask_param->init_done)
+        ttask_param->phase = kernel_compute_sys_ticks(time, unit);
+}
+
+void kernel_ttask_set_budget(struct kernel_ttask_param* const ttask_param, int time, int unit)
+{
+    if(NULL != ttask_param) {
+        ttask_param->budget = kernel_compute_sys_ticks(time, unit);
+#if (KERN_SCHEDULE_TABLE == 1)
+        kernel_schedule_dirty = true;
+#endif
+    }
+}
+
+void kernel_rtask_wait(struct kernel_rtask_param* const rtask_param, const struct kernel_event* event, unsigned int mask)
+{
+    if(NULL != rtask_param) {
+        rtask_param->wait_event = event;
+        rtask_param->wait_mask = mask;
+    }
+}
+
+void kernel_event_set(struct kernel_event* event, unsigned int mask)
+{
+    unsigned int status = sys_suspend_global_interrupt();
+    event->flags |= mask;
+    sys_resume_global_interrupt(status);
+}
+
+void kernel_event_clear(struct kernel_event* event, unsigned int mask)
+{
+    unsigned int status = sys_suspend_global_interrupt();
+    event->flags &= ~mask;
+    sys_resume_global_interrupt(status);
+}
+
+unsigned int kernel_event_take(struct kernel_event* event, unsigned int mask)
+{
+    unsigned int status = sys_suspend_global_interrupt();
+    unsigned int flags = event->flags & mask;
+    event->flags &= ~flags;
+    sys_resume_global_interrupt(status);
+    return flags;
 }
 
 static void kernel_init_configure_ttask(void)
@@ -164,6 +271,34 @@ static void kernel_init_ttask_call_sequence(void)
     kernel_restore_ttask_sorted_iterator();
 }
 
+static void kernel_init_ttask_phase(void)
+{
+    unsigned int spread = 0;
+    unsigned int count = 0;
+    unsigned int index = 0;
+    
+    if(NULL == kernel_ttask_sorted_begin)
+        return;
+    
+    // Spread the ttasks without a phase over the greatest common divisor of all intervals
+    do {
+        if(kernel_ttask_sorted_iterator->param->interval > 0)
+            spread = kernel_gcd(spread, kernel_ttask_sorted_iterator->param->interval);
+        if(KERN_TTASK_PHASE_AUTO == kernel_ttask_sorted_iterator->param->phase)
+            count++;
+        kernel_ttask_sorted_iterator = kernel_ttask_sorted_iterator->param->next;
+    } while(kernel_ttask_sorted_iterator != kernel_ttask_sorted_begin);
+    
+    // Higher priority ttasks go first
+    do {
+        struct kernel_ttask_param* param = kernel_ttask_sorted_iterator->param;
+        if(KERN_TTASK_PHASE_AUTO == param->phase)
+            param->phase = (spread * index++) / count;
+        param->ticks = param->phase;
+        kernel_ttask_sorted_iterator = param->next;
+    } while(kernel_ttask_sorted_iterator != kernel_ttask_sorted_begin);
+}
+
 static void kernel_init_task_init(void)
 {
     int init_level = KERN_INIT_EARLY;
@@ -211,8 +346,15 @@ static void kernel_execute_ttask_rtask(void)
 }
 
 static void kernel_execute_ttask(void)
+{
+    (*kernel_ttask_exec_func)();
+}
+
+static void kernel_execute_ttask_list(void)
 {
     struct kernel_ttask_param* param;
+    timer_size_t lateness;
+    unsigned int releases = 0;
     
     elapsed_ticks = (timer_size_t)(KERN_TMR_REG - previous_ticks);
     previous_ticks += elapsed_ticks;
@@ -220,6 +362,12 @@ static void kernel_execute_ttask(void)
     do {
         param = kernel_ttask_sorted_iterator->param;
         if(param->ticks <= elapsed_ticks) {
+            // The release was due when its ticks ran out
+            lateness = (timer_size_t)(KERN_TMR_REG - (timer_size_t)(previous_ticks - elapsed_ticks + param->ticks));
+            if(lateness > kernel_release_lateness)
+                kernel_release_lateness = lateness;
+            releases++;
+            
             param->ticks = param->interval;
             kernel_ttask_sorted_iterator->exec();
         } else
@@ -227,11 +375,134 @@ static void kernel_execute_ttask(void)
         
         kernel_ttask_sorted_iterator = param->next;
     } while(kernel_ttask_sorted_iterator != kernel_ttask_sorted_begin);
+    
+    kernel_releases += releases;
+    if(releases > 1)
+        kernel_coincident_releases += releases;
+    
+#if (KERN_SCHEDULE_TABLE == 1)
+    if(kernel_schedule_dirty)
+        kernel_schedule_update();
+#endif
+}
+
+#if (KERN_SCHEDULE_TABLE == 1)
+static void kernel_execute_ttask_table(void)
+{
+    const struct kernel_ttask* const* entry;
+    const struct kernel_ttask* const* end;
+    timer_size_t lateness;
+    
+    elapsed_ticks = (timer_size_t)(KERN_TMR_REG - previous_ticks);
+    if(elapsed_ticks < kernel_schedule_minor)
+        return;
+    
+    // Catch up if we are more than a minor frame behind
+    previous_ticks += kernel_schedule_minor;
+    if(elapsed_ticks >= 2 * kernel_schedule_minor)
+        kernel_schedule_overruns++;
+    
+    entry = &kernel_schedule_entries[kernel_schedule_slots[kernel_schedule_slot]];
+    end = &kernel_schedule_entries[kernel_schedule_slots[kernel_schedule_slot + 1]];
+    kernel_releases += end - entry;
+    if(end - entry > 1)
+        kernel_coincident_releases += end - entry;
+    while(entry != end) {
+        lateness = (timer_size_t)(KERN_TMR_REG - previous_ticks);
+        if(lateness > kernel_release_lateness)
+            kernel_release_lateness = lateness;
+        (*entry++)->exec();
+    }
+    
+    // Only pick up changes at the end of the major frame
+    if(++kernel_schedule_slot >= kernel_schedule_size) {
+        kernel_schedule_slot = 0;
+        if(kernel_schedule_dirty)
+            kernel_schedule_update();
+    }
 }
 
+static void kernel_schedule_update(void)
+{
+    const struct kernel_ttask* ttask;
+    
+    kernel_schedule_dirty = false;
+    kernel_schedule_slot = 0;
+    if(kernel_schedule_build()) {
+        kernel_ttask_exec_func = kernel_execute_ttask_table;
+        return;
+    }
+    
+    // Dispatch as usual, release all ttasks right away if the table was in charge
+    if(kernel_ttask_exec_func != kernel_execute_ttask_list) {
+        for(ttask = &__kernel_tstack_begin; ttask != kernel_ttask_end; ++ttask)
+            ttask->param->ticks = 0;
+        kernel_ttask_exec_func = kernel_execute_ttask_list;
+    }
+}
+
+static bool kernel_schedule_build(void)
+{
+    const struct kernel_ttask* ttask;
+    unsigned int minor = 0;
+    unsigned int major = 1;
+    unsigned int entries = 0;
+    unsigned int interval;
+    unsigned int budget;
+    unsigned int slot;
+    
+    // Minor frame is the greatest common divisor of all intervals, it must be measurable with the timer. Phases are
+    // left out, otherwise the spread phases shrink the minor frame below the budget of a single ttask
+    for(ttask = &__kernel_tstack_begin; ttask != kernel_ttask_end; ++ttask) {
+        if(ttask->param->interval <= 0)
+            return false;
+        minor = kernel_gcd(minor, ttask->param->interval);
+    }
+    if(minor > KERNEL_TIMER_MAX / 2)
+        return false;
+    
+    // Major frame is the least common multiple of all intervals, it must fit in the table
+    for(ttask = &__kernel_tstack_begin; ttask != kernel_ttask_end; ++ttask) {
+        interval = ttask->param->interval;
+        major /= kernel_gcd(major, interval);
+        if(major > (KERN_SCHEDULE_SLOTS * minor) / interval)
+            return false;
+        major *= interval;
+    }
+    
+    // Fill in the released ttasks of each minor frame in order of priority, a phase is rounded down to a minor frame
+    for(slot = 0; slot < major / minor; ++slot) {
+        kernel_schedule_slots[slot] = entries;
+        budget = 0;
+        ttask = kernel_ttask_sorted_begin;
+        do {
+            if((slot * minor) % ttask->param->interval == ((ttask->param->phase % ttask->param->interval) / minor) * minor) {
+                if(entries >= KERN_SCHEDULE_ENTRIES)
+                    return false;
+                kernel_schedule_entries[entries++] = ttask;
+                budget += ttask->param->budget;
+            }
+            ttask = ttask->param->next;
+        } while(ttask != kernel_ttask_sorted_begin);
+        
+        // Not schedulable, released ttasks don't fit in a minor frame
+        if(budget > minor)
+            return false;
+    }
+    kernel_schedule_slots[slot] = entries;
+    kernel_schedule_size = slot;
+    kernel_schedule_minor = minor;
+    return true;
+}
+#endif
+
 static void kernel_execute_rtask(void)
 {
-    kernel_rtask_iterator->exec();
+    const struct kernel_rtask_param* const param = kernel_rtask_iterator->param;
+    
+    // A waiting rtask is skipped until one of the awaited flags is set
+    if(NULL == param->wait_event || (param->wait_event->flags & param->wait_mask))
+        kernel_rtask_iterator->exec();
     if(++kernel_rtask_iterator == kernel_rtask_end)
         kernel_restore_rtask_iterator();
 }
@@ -251,4 +522,15 @@ static int kernel_compute_sys_ticks(int time, int unit)
         case KERN_TIME_UNIT_US: ticks = time / KERNEL_SYSTEM_TICK;                  break;
     }
     return ticks;
+}
+
+static unsigned int kernel_gcd(unsigned int a, unsigned int b)
+{
+    unsigned int remainder;
+    while(0 != b) {
+        remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
 }
\ No newline at end of file
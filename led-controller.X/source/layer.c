@@ -1,41 +1,150 @@
 #include "../include/layer.h"
 #include "../include/layer_config.h"
 #include "../include/kernel_task.h"
-#include "../include/tlc5940.h"
+#include "../include/driver.h"
+#include "../include/store.h"
+#include "../include/render.h"
+#include "../include/render_config.h"
 #include "../include/spi.h"
 #include "../include/dma.h"
+#include "../include/nvm.h"
 #include "../include/sys.h"
+#include "../include/assert.h"
 #include "../include/register.h"
 #include "../include/toolbox.h"
 #include <stddef.h>
+#include <string.h>
 #include <xc.h>
 
 #if !defined(LAYER_REFRESH_INTERVAL)
     #error "Layer refresh interval is not specified, please define 'LAYER_REFRESH_INTERVAL'"
+#elif !defined(LAYER_ROW_DEAD_TIME) || (LAYER_ROW_DEAD_TIME > LAYER_DEAD_TIME_MAX)
+    #error "Layer row dead-time must be at most 'LAYER_DEAD_TIME_MAX', please define 'LAYER_ROW_DEAD_TIME'"
+#elif !defined(LAYER_SKIP_BLACK_ROWS)
+    #error "Layer skip black rows is not specified, please define 'LAYER_SKIP_BLACK_ROWS'"
+#elif !defined(LAYER_GOVERNOR)
+    #error "Layer governor is not specified, please define 'LAYER_GOVERNOR'"
+#elif !defined(LAYER_INTERPOLATION)
+    #error "Layer interpolation is not specified, please define 'LAYER_INTERPOLATION'"
+#elif (LAYER_INTERPOLATION_MAX <= 0) || (LAYER_INTERPOLATION_MAX > 400)
+    #error "Layer maximum interpolation interval must be in between 1 and 400 ms"
+#elif !defined(LAYER_CRC)
+    #error "Layer CRC is not specified, please define 'LAYER_CRC'"
+#elif (LAYER_CRC == 1) && (LAYER_CRC_LENGTH != 16) && (LAYER_CRC_LENGTH != 32)
+    #error "Layer CRC length must be either 16 or 32 bits"
+#elif !defined(LAYER_SPI_MODE32)
+    #error "Layer SPI mode is not specified, please define 'LAYER_SPI_MODE32'"
+#elif !defined(LAYER_SPI_FRAMED)
+    #error "Layer SPI framed mode is not specified, please define 'LAYER_SPI_FRAMED'"
+#elif !defined(LAYER_QUEUE_DEPTH) || (LAYER_QUEUE_DEPTH < 1)
+    #error "Layer frame queue depth must be at least 1, please define 'LAYER_QUEUE_DEPTH'"
+#elif !defined(LAYER_LIMITER)
+    #error "Layer brightness limiter is not specified, please define 'LAYER_LIMITER'"
+#elif (LAYER_LIMITER == 1) && ((LAYER_LIMITER_BUDGET <= 0) || (LAYER_LIMITER_BUDGET > 100))
+    #error "Layer brightness limiter budget must be in between 1 and 100 percent"
+#elif !defined(LAYER_REMAP) || !defined(LAYER_CHANNEL_ORDER)
+    #error "Layer remap is not specified, please define 'LAYER_REMAP' and 'LAYER_CHANNEL_ORDER'"
+#elif !defined(LAYER_PATTERN_JUMPER) || !defined(LAYER_JUMPER_PATTERN) || !defined(LAYER_JUMPER_LEVEL)
+    #error "Layer test jumper is not specified, please define 'LAYER_PATTERN_JUMPER', 'LAYER_JUMPER_PATTERN' and 'LAYER_JUMPER_LEVEL'"
+#elif (LAYER_JUMPER_LEVEL < 1 || LAYER_JUMPER_LEVEL > 255)
+    #error "Layer test jumper level must be in between 1 and 255"
+#elif !defined(LAYER_PATTERN_STEP_TIME)
+    #error "Layer test pattern step time is not specified, please define 'LAYER_PATTERN_STEP_TIME'"
+#elif !defined(LAYER_BOARD_ADDRESS) || (LAYER_BOARD_ADDRESS < 0) || (LAYER_BOARD_ADDRESS >= LAYER_NUM_OF_ADDRESSES)
+    #error "Layer board address must be in between 0 and 'LAYER_NUM_OF_ADDRESSES' - 1, please define 'LAYER_BOARD_ADDRESS'"
+#elif !defined(LAYER_BOOT_FRAME)
+    #error "Layer boot frame is not specified, please define 'LAYER_BOOT_FRAME'"
+#elif (LAYER_REFRESH_INTERVAL < LAYER_REFRESH_INTERVAL_MIN) || (LAYER_REFRESH_INTERVAL > LAYER_REFRESH_INTERVAL_MAX)
+    #error "Layer refresh interval must be in between 'LAYER_REFRESH_INTERVAL_MIN' and 'LAYER_REFRESH_INTERVAL_MAX'"
+#elif !defined(LAYER_TTASK_BUDGET) || (LAYER_TTASK_BUDGET >= LAYER_REFRESH_INTERVAL_MIN)
+    #error "Layer ttask budget must be shorter than the refresh interval, please define 'LAYER_TTASK_BUDGET'"
 #endif
 
-#define LAYER_NUM_OF_ROWS           16
-#define LAYER_NUM_OF_COLS           16
-#define LAYER_NUM_OF_LEDS           (LAYER_NUM_OF_ROWS * LAYER_NUM_OF_COLS)
-#define LAYER_RED_OFFSET            (LAYER_NUM_OF_LEDS * 0)
-#define LAYER_GREEN_OFFSET          (LAYER_NUM_OF_LEDS * 1)
-#define LAYER_BLUE_OFFSET           (LAYER_NUM_OF_LEDS * 2)
 #define LAYER_FRAME_DEPTH           3 // RGB
 #define LAYER_FRAME_BUFFER_SIZE     (LAYER_NUM_OF_LEDS * LAYER_FRAME_DEPTH)
-#define LAYER_IO(pin, bank) \
-    { \
-        .ansel = NULL, \
-        .tris = atomic_reg_ptr_cast(&TRIS##bank), \
-        .lat = atomic_reg_ptr_cast(&LAT##bank), \
-        .mask = BIT(pin) \
-    }
-#define LAYER_ANSEL_IO(pin, bank) \
-    { \
-        .ansel = atomic_reg_ptr_cast(&ANSEL##bank), \
-        .tris = atomic_reg_ptr_cast(&TRIS##bank), \
-        .lat = atomic_reg_ptr_cast(&LAT##bank), \
-        .mask = BIT(pin) \
-    }
+#define LAYER_FRAME_BUFFER_WORDS    (LAYER_FRAME_BUFFER_SIZE / sizeof(unsigned int))
+#define LAYER_RAW_ROW_SIZE          DRIVER_RAW_SIZE // Grayscale bitstream of a row in the native driver format
+#define LAYER_RAW_ROW_WORDS         (LAYER_RAW_ROW_SIZE / sizeof(unsigned int))
+#define LAYER_RAW_FRAME_SIZE        (LAYER_RAW_ROW_SIZE * LAYER_NUM_OF_ROWS)
+#define LAYER_FRAME_MAX_SIZE        LAYER_RAW_FRAME_SIZE // Largest payload of all frame types
+
+#if (DRIVER_NUM_OF_DEVICES != LAYER_FRAME_DEPTH) || (DRIVER_CHANNELS_PER_DEVICE != LAYER_NUM_OF_COLS)
+    #error "LED driver must drive one color of a row per device"
+#elif (LAYER_NUM_OF_ROWS != LAYER_NUM_OF_COLS)
+    #error "Layer remap can only transpose a square layer"
+#endif
+#if (LAYER_CRC == 1)
+    #define LAYER_CRC_SIZE          (LAYER_CRC_LENGTH / 8)
+#else
+    #define LAYER_CRC_SIZE          0
+#endif
+#if (LAYER_SPI_MODE32 == 1)
+    #define LAYER_RECEIVE_ALIGN     8 // The DMA empties the receive FIFO once it holds two words
+    #define LAYER_SPI_MODE          (SPI_ENHBUF | SPI_SRXISEL_FULL_ONE_HALF | SPI_MODE32)
+#else
+    #define LAYER_RECEIVE_ALIGN     1
+    #define LAYER_SPI_MODE          (SPI_SRXISEL_NOT_EMPTY | SPI_MODE8)
+#endif
+#if (LAYER_SPI_MODE32 == 1) && (LAYER_CRC == 0)
+    #define LAYER_SWAP_WORDS        1 // Without the CRC engine the byte order of the received words is restored in software
+#else
+    #define LAYER_SWAP_WORDS        0
+#endif
+#if (LAYER_SPI_FRAMED == 1)
+    #define LAYER_SPI_SELECT        (SPI_FRMEN | SPI_FRMSYNC | SPI_FRMCNT) // Frame sync pulse input before each word
+#else
+    #define LAYER_SPI_SELECT        SPI_SSEN
+#endif
+#define LAYER_TRAILER_SIZE          (((LAYER_CRC_SIZE + LAYER_RECEIVE_ALIGN - 1) / LAYER_RECEIVE_ALIGN) * LAYER_RECEIVE_ALIGN) // Padded CRC
+#define LAYER_FRAME_RECEIVE_SIZE    (LAYER_FRAME_MAX_SIZE + LAYER_TRAILER_SIZE) // Frame followed by the trailer
+#define LAYER_ROW_NONE              LAYER_NUM_OF_ROWS
+#define LAYER_ROW_ALL_MASK          MASK(0xffff, 0)
+#define LAYER_ROW_WORDS             (LAYER_NUM_OF_COLS / sizeof(unsigned int)) // Words per row of a single color
+#define LAYER_WEIGHT_SHIFT          8
+#define LAYER_WEIGHT_MAX            BIT(LAYER_WEIGHT_SHIFT) // Weight of the current frame when fully blended
+#define LAYER_LOAD_BATCH            128 // Words summed in 16 bit lanes before they could overflow
+#define LAYER_LIMITER_ROW_LOAD      ((LAYER_LIMITER_BUDGET * LAYER_NUM_OF_COLS * LAYER_FRAME_DEPTH * 255U) / 100) // Budget per row
+#define LAYER_INTERPOLATION_TICKS   SYS_CORE_TIMER_TICKS(LAYER_INTERPOLATION_MAX * 1000000LU)
+#define LAYER_TIMEBASE_TICKS        SYS_CORE_TIMER_TICKS(1000) // Core timer ticks per us of the timebase
+#define LAYER_FRAME_SIZE_UNKNOWN    (~0U)
+#define LAYER_PATTERN_FRAME_SIZE    8 // Pattern, level and padding
+#define LAYER_RECT_OFFSET           LAYER_FRAME_BUFFER_SIZE // Rectangles are received behind the RGB planes
+#define LAYER_RECT_MAX_SIZE         (LAYER_FRAME_MAX_SIZE - LAYER_RECT_OFFSET)
+#define LAYER_RECT_HEADER_SIZE      4 // x, y, width and height
+#define LAYER_INDEXED_FRAME_SIZE    LAYER_NUM_OF_LEDS // Palette index of each LED
+#define LAYER_PALETTE_SIZE          256
+#define LAYER_PALETTE_HEADER_SIZE   2 // First entry and number of entries
+#define LAYER_PATTERN_STEP_TICKS    SYS_CORE_TIMER_TICKS(LAYER_PATTERN_STEP_TIME * 1000000LU)
+#define LAYER_JUMPER_SETTLE_TICKS   SYS_CORE_TIMER_TICKS(10000) // Pull-up settle time
+#define LAYER_FRAME_FLAG_TIMESTAMP  BIT(0) // Timestamp of the header is the presentation time
+#define LAYER_FRAME_FLAG_ADDRESSED  BIT(1) // Frame is only for the board with the address in the upper nibble
+#define LAYER_FRAME_ADDRESS(flags)  ((flags) >> 4)
+#define LAYER_REMAP_PERMUTED        BIT(7) // Stored along with the orientation once a permutation is stored
+#define LAYER_EVENT_RECEIVE         BIT(0) // A frame receive was requested
+#define LAYER_EVENT_RECEIVED        BIT(1) // The frame DMA finished, either done or invalid
+#if (LAYER_INTERPOLATION == 1)
+    #define LAYER_FRAME_RESERVED    2 // Drawn and previous frame
+#else
+    #define LAYER_FRAME_RESERVED    1 // Drawn frame
+#endif
+#define LAYER_FRAME_COUNT           (LAYER_FRAME_RESERVED + LAYER_QUEUE_DEPTH + 2) // Reserved, queued, receiving and canvas frames
+
+#if (LAYER_BOOT_FRAME == 1)
+    #include "../include/layer_boot_frame.h"
+#endif
+
+#define LAYER_ROW_D(pin)                { .portd = BIT(pin), .porte = 0 }
+#define LAYER_ROW_E(pin)                { .portd = 0, .porte = BIT(pin) }
+
+#define LAYER_ROW_ANSELD                atomic_reg_ptr_cast(&ANSELD)
+#define LAYER_ROW_ANSELE                atomic_reg_ptr_cast(&ANSELE)
+#define LAYER_ROW_TRISD                 atomic_reg_ptr_cast(&TRISD)
+#define LAYER_ROW_TRISE                 atomic_reg_ptr_cast(&TRISE)
+#define LAYER_ROW_LATD                  atomic_reg_ptr_cast(&LATD)
+#define LAYER_ROW_LATE                  atomic_reg_ptr_cast(&LATE)
+
+#define LAYER_ROW_PORTD_MASK            MASK(0xfff, 0) // All row pins of PORTD
+#define LAYER_ROW_PORTE_MASK            MASK(0xf, 0) // All row pins of PORTE
 
 #define LAYER_SPI_CHANNEL               SPI_CHANNEL1
 #define LAYER_SDI_PPS                   SDI1R
@@ -53,13 +162,73 @@
 #define LAYER_SCK_PIN_MASK              BIT(6)
 #define LAYER_SS_PIN_MASK               BIT(15)
 
-struct layer_io
+#define LAYER_JUMPER_TRIS               TRISB
+#define LAYER_JUMPER_ANSEL              ANSELB
+#define LAYER_JUMPER_CNPU               CNPUB
+#define LAYER_JUMPER_PORT               PORTB
+#define LAYER_JUMPER_PIN_MASK           BIT(2)
+
+struct layer_frame_header
 {
-    atomic_reg_ptr(ansel);
-    atomic_reg_ptr(tris);
-    atomic_reg_ptr(lat);
-    
-    unsigned int mask;
+    unsigned char type; // See layer_frame_type
+    unsigned char flags; // See LAYER_FRAME_FLAG_*
+    unsigned short size; // Payload size in bytes, excluding the trailer
+    unsigned int timestamp; // Presentation time or current time for a sync in us of the master's timebase
+};
+
+struct layer_frame
+{
+    unsigned char buffer[LAYER_FRAME_RECEIVE_SIZE] __attribute__((aligned(4))); // Aligned for word-at-a-time access
+    unsigned int rows; // Mask of the rows to refresh
+    unsigned int timestamp; // Core timer value of the frame presentation
+    unsigned int due; // Core timer value of the presentation time
+    unsigned int load; // Sum of all values, estimate of the LED current
+    unsigned char type; // See layer_frame_type
+};
+
+struct layer_governor
+{
+    unsigned int interval;  // Current refresh interval in us
+    unsigned int period;    // Current refresh interval in core timer ticks
+    unsigned int settle;    // Number of consecutive scans that allowed a shorter interval
+    unsigned int prep;      // Longest row preparation time of the current scan in core timer ticks
+    unsigned int shift;     // Longest time from update to latch of the current scan in core timer ticks
+    unsigned int lateness;  // Longest release lateness of the ttask in the current scan in core timer ticks
+    unsigned int misses;    // Number of rows that were not latched in time during the current scan
+    unsigned int released;  // Core timer value of the previous ttask release
+    unsigned int updated;   // Core timer value of the previous update
+};
+
+struct layer_limiter
+{
+    unsigned int scale;     // Current brightness scale in 1/256
+    unsigned int target;    // Brightness scale of the presented frame in 1/256
+};
+
+struct layer_row
+{
+    unsigned int portd;
+    unsigned int porte;
+};
+
+enum layer_frame_type
+{
+    LAYER_FRAME_TYPE_RGB = 0,   // 8 bit red, green and blue planes
+    LAYER_FRAME_TYPE_RAW,       // Grayscale bitstream of each row
+    LAYER_FRAME_TYPE_SYNC,      // Timebase sync without payload
+    LAYER_FRAME_TYPE_PATTERN,   // Test pattern selection
+    LAYER_FRAME_TYPE_RECT,      // Rectangles updating the most recent frame
+    LAYER_FRAME_TYPE_DRAW,      // Render commands, see render.h
+    LAYER_FRAME_TYPE_INDEXED,   // 8 bit palette index of each LED
+    LAYER_FRAME_TYPE_PALETTE,   // Palette entries, applied once presented
+};
+
+enum layer_receive_phase
+{
+    LAYER_RECEIVE_HEADER = 0,
+    LAYER_RECEIVE_PAYLOAD,
+    LAYER_RECEIVE_DONE,
+    LAYER_RECEIVE_INVALID,
 };
 
 enum layer_state
@@ -71,54 +240,159 @@ enum layer_state
 };
 
 static void layer_latch_callback(void);
+static void layer_dma_transfer_complete(struct dma_channel* channel);
+static unsigned int layer_frame_size(unsigned int type, unsigned int size);
+#if (LAYER_SWAP_WORDS == 1)
+static void layer_swap_words(void* buffer, unsigned int size);
+#endif
+static struct layer_frame* layer_acquire_frame(void);
+static void layer_release_frame(struct layer_frame* frame);
+static void layer_drop_frame(void);
+static void layer_queue_frame(void);
+static void layer_enqueue_frame(struct layer_frame* frame);
+static void layer_copy_recent_frame(struct layer_frame* frame);
+static bool layer_blit_rects(void);
+static void layer_present_frame(void);
+static bool layer_palette_valid(const struct layer_frame* frame, unsigned int size);
+static void layer_palette_apply(const struct layer_frame* frame);
+static void layer_sync_timebase(void);
+static unsigned int layer_frame_rows(const struct layer_frame* frame);
+static unsigned int layer_frame_load(const struct layer_frame* frame);
+static unsigned int layer_indexed_rows(const struct layer_frame* frame);
+static unsigned int layer_indexed_load(const struct layer_frame* frame);
+static void layer_remap_build(unsigned int remap, const unsigned char* permutation);
+static void layer_remap_frames(void);
+static bool layer_limiter_aim(unsigned int load, unsigned int rows);
+static void layer_limiter_execute(void);
+static unsigned int layer_pattern_load(unsigned int pattern, unsigned int level);
+static void layer_pattern_execute(void);
+static unsigned int layer_scan_mask(void);
+static void layer_scan_build(unsigned int rows);
+static unsigned int layer_interpolation_weight(void);
+inline static unsigned int __attribute__((always_inline)) layer_blend(unsigned int from, unsigned int to, unsigned int weight);
+static void layer_pack_row(unsigned int row);
+static void layer_pack_pattern(unsigned int row);
+static void layer_pack_indexed(unsigned int row);
+static void layer_governor_execute(void);
+static void layer_governor_apply(unsigned int interval);
 static int layer_ttask_init(void);
 static void layer_ttask_execute(void);
 static void layer_ttask_configure(struct kernel_ttask_param* const param);
 static int layer_rtask_init(void);
 static void layer_rtask_execute(void);
+static void layer_rtask_configure(struct kernel_rtask_param* const param);
 KERN_TTASK(layer, layer_ttask_init, layer_ttask_execute, layer_ttask_configure, KERN_INIT_LATE);
-KERN_QUICK_RTASK(layer, layer_rtask_init, layer_rtask_execute); // No init necessary
-
-static const struct layer_io layer_io[LAYER_NUM_OF_ROWS] =
-{
-    LAYER_IO(7, D), // Row 0
-    LAYER_IO(6, D), // Row 1
-    LAYER_IO(5, D), // ...
-    LAYER_IO(4, D),
-    LAYER_ANSEL_IO(3, D),
-    LAYER_ANSEL_IO(2, D),
-    LAYER_ANSEL_IO(1, D),
-    LAYER_IO(0, D),
-    LAYER_IO(3, E),
-    LAYER_ANSEL_IO(2, E),
-    LAYER_IO(1, E),
-    LAYER_IO(0, E),
-    LAYER_IO(11, D),
-    LAYER_IO(10, D),
-    LAYER_IO(9, D),
-    LAYER_IO(8, D),
+KERN_RTASK(layer, layer_rtask_init, layer_rtask_execute, layer_rtask_configure, KERN_INIT_LATE);
+KERN_EVENT(layer_events);
+
+static const unsigned char layer_channel_order[LAYER_NUM_OF_COLS] = LAYER_CHANNEL_ORDER;
+
+// Port-wide set masks of each row, switching off a row simply clears all row pins of both ports
+static const struct layer_row layer_rows[LAYER_NUM_OF_ROWS] =
+{
+    LAYER_ROW_D(7), // Row 0
+    LAYER_ROW_D(6), // Row 1
+    LAYER_ROW_D(5), // ...
+    LAYER_ROW_D(4),
+    LAYER_ROW_D(3),
+    LAYER_ROW_D(2),
+    LAYER_ROW_D(1),
+    LAYER_ROW_D(0),
+    LAYER_ROW_E(3),
+    LAYER_ROW_E(2),
+    LAYER_ROW_E(1),
+    LAYER_ROW_E(0),
+    LAYER_ROW_D(11),
+    LAYER_ROW_D(10),
+    LAYER_ROW_D(9),
+    LAYER_ROW_D(8),
 };
 
-static const struct dma_config layer_dma_config; // No special config needed
+static const struct dma_config layer_dma_config =
+{
+    .block_transfer_complete = layer_dma_transfer_complete,
+    .crc =
+    {
+        .enable = LAYER_CRC == 1,
+        .swap_bytes = LAYER_SPI_MODE32 == 1, // The engine also restores the byte order of received words
+        .polynomial = LAYER_CRC_POLYNOMIAL,
+        .length = LAYER_CRC_LENGTH,
+        .seed = 0,
+    },
+};
 static const struct spi_config layer_spi_config =
 {
-    .spicon_flags = SPI_SRXISEL_NOT_EMPTY | SPI_DISSDO | SPI_MODE8 | SPI_SSEN,
+    .spicon_flags = LAYER_SPI_MODE | LAYER_SPI_SELECT | SPI_DISSDO,
 };
 
-static unsigned char layer_front_buffer[LAYER_FRAME_BUFFER_SIZE];
-static unsigned char layer_back_buffer[LAYER_FRAME_BUFFER_SIZE];
-static unsigned char* layer_dma_ptr = layer_back_buffer;
-static unsigned char* layer_draw_ptr = layer_front_buffer;
-static const struct layer_io* layer_row_io = layer_io;
-static const struct layer_io* layer_row_previous_io = &layer_io[LAYER_NUM_OF_ROWS - 1];
+static struct layer_frame_header layer_header;
+static struct layer_frame layer_frame_pool[LAYER_FRAME_COUNT];
+static struct layer_frame* layer_free_frames[LAYER_FRAME_COUNT];
+static unsigned int layer_free_count = 0;
+static struct layer_frame* layer_queue[LAYER_QUEUE_DEPTH]; // Frames waiting for their presentation time, in order of arrival
+static unsigned int layer_queue_head = 0;
+static unsigned int layer_queue_count = 0;
+static struct layer_frame* layer_dma_frame = NULL;
+static struct layer_frame* layer_canvas_frame = NULL;
+static struct layer_frame* layer_draw_frame = &layer_frame_pool[0];
+#if (LAYER_INTERPOLATION == 1)
+static struct layer_frame* layer_previous_frame = &layer_frame_pool[1];
+#endif
+static unsigned int layer_header_received = 0; // Core timer value at the end of the header
+static unsigned int layer_timebase_offset = 0; // Core timer value minus the master's timebase in ticks
+static bool layer_timebase_synced = false;
+static unsigned char layer_palette[LAYER_PALETTE_SIZE][LAYER_FRAME_DEPTH]; // Red, green and blue of each entry
+static unsigned short layer_gamma[LAYER_GAMMA_SIZE]; // 8.8 fixed point level of each 8 bit value
+static unsigned int layer_address = LAYER_BOARD_ADDRESS;
+static unsigned char layer_remap[LAYER_NUM_OF_LEDS]; // Source LED of each channel of each row
+static unsigned char layer_remap_rows[LAYER_NUM_OF_ROWS]; // Source row of each row, if not mixed
+static bool layer_remap_mixed = false; // Whether a row takes its values from several source rows
+static unsigned int layer_remap_orientation = LAYER_REMAP_NONE;
+static unsigned char layer_scan_rows[LAYER_NUM_OF_ROWS];
+static unsigned int layer_scan_size = 0;
+static unsigned int layer_scan_index = 0;
 static struct dma_channel* layer_dma_channel = NULL;
 static struct spi_module* layer_spi_module = NULL;
 static enum layer_state layer_state = LAYER_IDLE;
-static unsigned int layer_row_index = 0;
+static volatile enum layer_receive_phase layer_receive_phase = LAYER_RECEIVE_HEADER;
+static unsigned int layer_row_index = LAYER_ROW_NONE;
+static bool layer_row_lit = false;
+static volatile bool layer_blanked = false; // No row is switched on, e.g. while the CPU stalls on a flash erase
 static unsigned int layer_red_index = 0;
 static unsigned int layer_green_index = 0;
 static unsigned int layer_blue_index = 0;
 static unsigned int layer_offset = 0;
+static unsigned int layer_dead_time_ticks = SYS_CORE_TIMER_TICKS(LAYER_ROW_DEAD_TIME);
+static unsigned int layer_dead_time_measured = 0;
+static unsigned int layer_deadline_misses = 0;
+static unsigned int layer_pack_measured = 0;
+static unsigned int layer_frames = 0;
+static unsigned int layer_crc_errors = 0;
+static unsigned int layer_header_errors = 0;
+static unsigned int layer_overruns = 0;
+static unsigned int layer_payload_delay = 0;
+static unsigned int layer_late_frames = 0;
+static unsigned int layer_dropped_frames = 0;
+static unsigned int layer_render_rejects = 0;
+static unsigned int layer_foreign_frames = 0;
+static unsigned int layer_limited_frames = 0;
+static unsigned int layer_boot_time = 0; // Core timer value of the first latch, the core timer is cleared at boot
+static unsigned int layer_pattern_shown = LAYER_PATTERN_NONE;
+static unsigned int layer_pattern_level = 0;
+static unsigned int layer_pattern_position = 0; // Step of the moving patterns
+static unsigned int layer_pattern_stepped = 0; // Core timer value of the last step
+static struct kernel_ttask_param* layer_ttask_param = NULL;
+static struct kernel_rtask_param* layer_rtask_param = NULL;
+static struct layer_limiter layer_limiter =
+{
+    .scale = LAYER_WEIGHT_MAX,
+    .target = LAYER_WEIGHT_MAX,
+};
+static struct layer_governor layer_governor =
+{
+    .interval = LAYER_REFRESH_INTERVAL,
+    .period = SYS_CORE_TIMER_TICKS(LAYER_REFRESH_INTERVAL * 1000LU),
+};
 
 bool layer_busy(void)
 {
@@ -136,64 +410,1058 @@ bool layer_receive_frame(void)
         return false;
     
     layer_state = LAYER_RECEIVE_FRAME;
+    kernel_event_set(&layer_events, LAYER_EVENT_RECEIVE);
+    return true;
+}
+
+bool layer_set_dead_time(unsigned int dead_time)
+{
+    if(dead_time > LAYER_DEAD_TIME_MAX)
+        return false;
+    
+    // Kept across resets, measure the new dead-time from scratch
+    layer_dead_time_ticks = SYS_CORE_TIMER_TICKS(dead_time);
+    layer_dead_time_measured = 0;
+    store_set(STORE_KEY_DEAD_TIME, &dead_time, sizeof(dead_time));
+    return true;
+}
+
+void layer_blank(bool blank)
+{
+    // Set first, so the latch callback doesn't switch a row on again
+    layer_blanked = blank;
+    if(blank) {
+        atomic_reg_ptr_clr(LAYER_ROW_LATD, LAYER_ROW_PORTD_MASK);
+        atomic_reg_ptr_clr(LAYER_ROW_LATE, LAYER_ROW_PORTE_MASK);
+    }
+}
+
+bool layer_set_address(unsigned int address)
+{
+    unsigned char stored = address;
+    
+    if(address >= LAYER_NUM_OF_ADDRESSES)
+        return false;
+    
+    // Kept across resets
+    layer_address = address;
+    store_set(STORE_KEY_BOARD_ADDRESS, &stored, sizeof(stored));
+    return true;
+}
+
+void layer_set_gamma(const unsigned short* gamma)
+{
+    // Without a table, fall back to a linear response
+    for(unsigned int i = 0; i < LAYER_GAMMA_SIZE; ++i)
+        layer_gamma[i] = NULL != gamma ? gamma[i] : i << LAYER_WEIGHT_SHIFT;
+    
+    // Kept across resets
+    store_set(STORE_KEY_GAMMA, layer_gamma, sizeof(layer_gamma));
+}
+
+bool layer_set_refresh_interval(unsigned int interval)
+{
+    if(interval < LAYER_REFRESH_INTERVAL_MIN || interval > LAYER_REFRESH_INTERVAL_MAX)
+        return false;
+    
+    // Kept across resets, the governor starts from this interval
+    layer_governor_apply(interval);
+    store_set(STORE_KEY_REFRESH_INTERVAL, &interval, sizeof(interval));
+    return true;
+}
+
+bool layer_set_remap(unsigned int remap)
+{
+    unsigned char stored;
+    
+    if(remap & ~LAYER_REMAP_MASK)
+        return false;
+    
+    layer_remap_orientation = remap;
+    layer_remap_build(remap, NULL);
+    layer_remap_frames();
+    
+    // Kept across resets, the stored permutation no longer applies
+    stored = remap;
+    store_set(STORE_KEY_REMAP, &stored, sizeof(stored));
+    return true;
+}
+
+void layer_set_permutation(const unsigned char* permutation)
+{
+    unsigned char stored = layer_remap_orientation;
+    
+    // Without a permutation, fall back to the orientation
+    layer_remap_build(layer_remap_orientation, permutation);
+    layer_remap_frames();
+    
+    // Kept across resets
+    if(NULL != permutation) {
+        store_set(STORE_KEY_PERMUTATION, permutation, LAYER_NUM_OF_LEDS);
+        stored |= LAYER_REMAP_PERMUTED;
+    }
+    store_set(STORE_KEY_REMAP, &stored, sizeof(stored));
+}
+
+unsigned char* layer_canvas_begin(void)
+{
+    if(NULL != layer_canvas_frame)
+        return NULL;
+    
+    // A frame is set aside for the canvas, so this never drops a queued frame
+    layer_canvas_frame = layer_acquire_frame();
+    layer_copy_recent_frame(layer_canvas_frame);
+    return layer_canvas_frame->buffer;
+}
+
+void layer_canvas_commit(void)
+{
+    if(NULL == layer_canvas_frame)
+        return;
+    
+    layer_canvas_frame->type = LAYER_FRAME_TYPE_RGB;
+    layer_canvas_frame->due = sys_core_timer();
+    layer_enqueue_frame(layer_canvas_frame);
+    layer_canvas_frame = NULL;
+}
+
+bool layer_set_pattern(unsigned int pattern, unsigned int level)
+{
+    if(pattern >= __LAYER_PATTERN_COUNT || level > 255)
+        return false;
+    
+    layer_pattern_shown = pattern;
+    layer_pattern_level = level;
+    layer_pattern_position = 0;
+    layer_pattern_stepped = sys_core_timer();
+    
+    // The pattern replaces the frame, so does its load
+    if(LAYER_PATTERN_NONE == pattern)
+        layer_limiter_aim(layer_draw_frame->load, layer_draw_frame->rows);
+    else
+        layer_limiter_aim(layer_pattern_load(pattern, level), LAYER_ROW_ALL_MASK);
     return true;
 }
 
+struct layer_statistics layer_statistics(void)
+{
+    struct layer_statistics statistics =
+    {
+        .dead_time = SYS_CORE_TIMER_NS(layer_dead_time_measured),
+        .active_rows = layer_scan_size,
+        .refresh_interval = layer_governor.interval,
+        .deadline_misses = layer_deadline_misses,
+        .pack_time = SYS_CORE_TIMER_NS(layer_pack_measured),
+        .frames = layer_frames,
+        .crc_errors = layer_crc_errors,
+        .header_errors = layer_header_errors,
+        .overruns = layer_overruns,
+        .payload_delay = SYS_CORE_TIMER_NS(layer_payload_delay),
+        .queued_frames = layer_queue_count,
+        .late_frames = layer_late_frames,
+        .dropped_frames = layer_dropped_frames,
+        .render_rejects = layer_render_rejects,
+        .foreign_frames = layer_foreign_frames,
+        .limiter_scale = layer_limiter.scale,
+        .limited_frames = layer_limited_frames,
+        .boot_time = SYS_CORE_TIMER_US(layer_boot_time),
+    };
+    
+    // The dead-time is spent once per row period
+    statistics.dead_time_cost = (statistics.dead_time * 1000LU) / layer_governor.interval;
+    return statistics;
+}
+
 static void layer_latch_callback(void)
 {
-    atomic_reg_ptr_clr(layer_row_previous_io->lat, layer_row_previous_io->mask);
-    atomic_reg_ptr_set(layer_row_io->lat, layer_row_io->mask);
+    const struct layer_row* row;
+    unsigned int begin;
+    unsigned int dead_time;
+    
+    atomic_reg_ptr_clr(LAYER_ROW_LATD, LAYER_ROW_PORTD_MASK);
+    atomic_reg_ptr_clr(LAYER_ROW_LATE, LAYER_ROW_PORTE_MASK);
+    begin = sys_core_timer();
+    
+    if(0 == layer_boot_time)
+        layer_boot_time = begin;
+    if(begin - layer_governor.updated > layer_governor.shift)
+        layer_governor.shift = begin - layer_governor.updated;
+    
+    layer_row_lit = LAYER_ROW_NONE != layer_row_index && !layer_blanked;
+    if(layer_row_lit) {
+        row = &layer_rows[layer_row_index];
+        
+        // Let the row drivers discharge before switching on the next row
+        sys_core_timer_wait(begin, layer_dead_time_ticks);
+        atomic_reg_ptr_set(LAYER_ROW_LATD, row->portd);
+        atomic_reg_ptr_set(LAYER_ROW_LATE, row->porte);
+
+        dead_time = sys_core_timer() - begin;
+        if(dead_time > layer_dead_time_measured)
+            layer_dead_time_measured = dead_time;
+    }
     
     // Advance to next row
-    layer_row_previous_io = layer_row_io;
-    if(++layer_row_index >= LAYER_NUM_OF_ROWS) {
-        layer_row_index = 0;
-        layer_row_io = layer_io;
+    if(++layer_scan_index >= layer_scan_size)
+        layer_scan_index = 0;
+}
+
+static void layer_dma_transfer_complete(struct dma_channel* channel)
+{
+    unsigned int size;
+    unsigned int delay;
+    
+    switch(layer_receive_phase) {
+        case LAYER_RECEIVE_HEADER:
+            layer_header_received = sys_core_timer();
+#if (LAYER_SWAP_WORDS == 1)
+            layer_swap_words(&layer_header, sizeof(layer_header));
+#endif
+            
+            // Receive the payload right away, the SPI module doesn't buffer much
+            size = layer_frame_size(layer_header.type, layer_header.size);
+            if(LAYER_FRAME_SIZE_UNKNOWN == size || layer_header.size != size) {
+                layer_receive_phase = LAYER_RECEIVE_INVALID;
+                kernel_event_set(&layer_events, LAYER_EVENT_RECEIVED);
+                break;
+            }
+            if(0 == size + LAYER_TRAILER_SIZE) {
+                layer_receive_phase = LAYER_RECEIVE_DONE;
+                kernel_event_set(&layer_events, LAYER_EVENT_RECEIVED);
+                break;
+            }
+            if(LAYER_FRAME_TYPE_RECT == layer_header.type)
+                dma_configure_dst(channel, &layer_dma_frame->buffer[LAYER_RECT_OFFSET], size + LAYER_TRAILER_SIZE);
+            else
+                dma_configure_dst(channel, layer_dma_frame->buffer, size + LAYER_TRAILER_SIZE);
+            dma_enable_transfer(channel);
+            layer_receive_phase = LAYER_RECEIVE_PAYLOAD;
+            
+            // Payload bytes that arrive meanwhile wait in the receive FIFO, the master has to pause for the rest
+            delay = sys_core_timer() - layer_header_received;
+            if(delay > layer_payload_delay)
+                layer_payload_delay = delay;
+            break;
+        case LAYER_RECEIVE_PAYLOAD:
+            layer_receive_phase = LAYER_RECEIVE_DONE;
+            kernel_event_set(&layer_events, LAYER_EVENT_RECEIVED);
+            break;
+        default:
+            break;
+    }
+}
+
+static unsigned int layer_frame_size(unsigned int type, unsigned int size)
+{
+    switch(type) {
+        case LAYER_FRAME_TYPE_RECT:
+            // Any number of rectangles, received in whole blocks
+            if(size > LAYER_RECT_MAX_SIZE || 0 != size % LAYER_RECEIVE_ALIGN)
+                return LAYER_FRAME_SIZE_UNKNOWN;
+            return size;
+        case LAYER_FRAME_TYPE_INDEXED:
+            return LAYER_INDEXED_FRAME_SIZE;
+        case LAYER_FRAME_TYPE_PALETTE:
+            // Any number of entries, received in whole blocks
+            if(size > LAYER_FRAME_MAX_SIZE || 0 != size % LAYER_RECEIVE_ALIGN)
+                return LAYER_FRAME_SIZE_UNKNOWN;
+            return size;
+        case LAYER_FRAME_TYPE_DRAW:
+            // Any number of commands that fit the renderer, received in whole blocks
+            if(size > RENDER_COMMAND_SIZE || 0 != size % LAYER_RECEIVE_ALIGN)
+                return LAYER_FRAME_SIZE_UNKNOWN;
+            return size;
+        case LAYER_FRAME_TYPE_RGB:      return LAYER_FRAME_BUFFER_SIZE;
+        case LAYER_FRAME_TYPE_RAW:      return LAYER_RAW_FRAME_SIZE;
+        case LAYER_FRAME_TYPE_SYNC:     return 0;
+        case LAYER_FRAME_TYPE_PATTERN:  return LAYER_PATTERN_FRAME_SIZE;
+        default:                        return LAYER_FRAME_SIZE_UNKNOWN;
+    }
+}
+
+#if (LAYER_SWAP_WORDS == 1)
+static void layer_swap_words(void* buffer, unsigned int size)
+{
+    unsigned int* word = buffer;
+    
+    // The SPI module receives the first byte of a word into its most significant byte
+    for(unsigned int i = 0; i < size / sizeof(unsigned int); ++i)
+        word[i] = __builtin_bswap32(word[i]);
+}
+#endif
+
+static struct layer_frame* layer_acquire_frame(void)
+{
+    // Queue is full, make room by dropping the oldest frame
+    if(0 == layer_free_count) {
+        ASSERT(LAYER_QUEUE_DEPTH == layer_queue_count);
+        layer_drop_frame();
+    }
+    return layer_free_frames[--layer_free_count];
+}
+
+static void layer_release_frame(struct layer_frame* frame)
+{
+    ASSERT(layer_free_count < LAYER_FRAME_COUNT);
+    layer_free_frames[layer_free_count++] = frame;
+}
+
+static void layer_drop_frame(void)
+{
+    struct layer_frame* frame;
+    unsigned int i;
+    
+    // Drop the oldest pixel frame, the palettes stay queued in order
+    for(i = 0; i < layer_queue_count; ++i) {
+        frame = layer_queue[(layer_queue_head + i) % LAYER_QUEUE_DEPTH];
+        if(LAYER_FRAME_TYPE_PALETTE != frame->type)
+            break;
+    }
+    
+    // Only palettes are queued, a palette is never lost so apply the oldest one early
+    if(i == layer_queue_count) {
+        frame = layer_queue[layer_queue_head];
+        layer_palette_apply(frame);
+        layer_release_frame(frame);
+        layer_queue_head = (layer_queue_head + 1) % LAYER_QUEUE_DEPTH;
+        layer_queue_count--;
+        return;
+    }
+    
+    for(; i + 1 < layer_queue_count; ++i)
+        layer_queue[(layer_queue_head + i) % LAYER_QUEUE_DEPTH] = layer_queue[(layer_queue_head + i + 1) % LAYER_QUEUE_DEPTH];
+    layer_release_frame(frame);
+    layer_queue_count--;
+    layer_dropped_frames++;
+}
+
+static void layer_queue_frame(void)
+{
+    struct layer_frame* frame = layer_dma_frame;
+    
+    // Rectangles leave a complete RGB frame behind
+    frame->type = LAYER_FRAME_TYPE_RECT == layer_header.type ? LAYER_FRAME_TYPE_RGB : layer_header.type;
+    
+    // Without a timestamp or a timebase, the frame is presented right away
+    frame->due = layer_header_received;
+    if(layer_timebase_synced && (layer_header.flags & LAYER_FRAME_FLAG_TIMESTAMP))
+        frame->due = layer_header.timestamp * LAYER_TIMEBASE_TICKS + layer_timebase_offset;
+    
+    ASSERT(layer_queue_count < LAYER_QUEUE_DEPTH);
+    layer_enqueue_frame(frame);
+    layer_dma_frame = NULL;
+}
+
+static void layer_enqueue_frame(struct layer_frame* frame)
+{
+    // A palette is only applied once presented
+    if(LAYER_FRAME_TYPE_PALETTE != frame->type) {
+        frame->rows = layer_frame_rows(frame);
+        frame->load = layer_frame_load(frame);
+    }
+    
+    // Queue is full, make room by dropping the oldest frame
+    if(LAYER_QUEUE_DEPTH == layer_queue_count)
+        layer_drop_frame();
+    layer_queue[(layer_queue_head + layer_queue_count) % LAYER_QUEUE_DEPTH] = frame;
+    layer_queue_count++;
+}
+
+static void layer_copy_recent_frame(struct layer_frame* frame)
+{
+    const struct layer_frame* recent = layer_draw_frame;
+    
+    // The last queued frame with pixels, otherwise the presented frame. Palettes don't carry pixels
+    for(unsigned int i = layer_queue_count; i > 0; --i) {
+        if(LAYER_FRAME_TYPE_PALETTE != layer_queue[(layer_queue_head + i - 1) % LAYER_QUEUE_DEPTH]->type) {
+            recent = layer_queue[(layer_queue_head + i - 1) % LAYER_QUEUE_DEPTH];
+            break;
+        }
+    }
+    
+    // Only RGB and indexed frames can be updated, an indexed frame is expanded with the current palette. Otherwise start from black
+    if(LAYER_FRAME_TYPE_RGB == recent->type)
+        memcpy(frame->buffer, recent->buffer, LAYER_FRAME_BUFFER_SIZE);
+    else if(LAYER_FRAME_TYPE_INDEXED == recent->type) {
+        for(unsigned int i = 0; i < LAYER_NUM_OF_LEDS; ++i) {
+            for(unsigned int j = 0; j < LAYER_FRAME_DEPTH; ++j)
+                frame->buffer[j * LAYER_NUM_OF_LEDS + i] = layer_palette[recent->buffer[i]][j];
+        }
+    } else
+        memset(frame->buffer, 0, LAYER_FRAME_BUFFER_SIZE);
+}
+
+static bool layer_blit_rects(void)
+{
+    struct layer_frame* frame = layer_dma_frame;
+    const unsigned char* rect = &frame->buffer[LAYER_RECT_OFFSET];
+    const unsigned char* end = rect + layer_header.size;
+    unsigned char* dst;
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+    unsigned int height;
+    
+    layer_copy_recent_frame(frame);
+    
+    // Trailing bytes that don't make up a rectangle header are padding
+    while(end - rect >= LAYER_RECT_HEADER_SIZE) {
+        x = rect[0];
+        y = rect[1];
+        width = rect[2];
+        height = rect[3];
+        rect += LAYER_RECT_HEADER_SIZE;
+        if(x + width > LAYER_NUM_OF_COLS || y + height > LAYER_NUM_OF_ROWS)
+            return false;
+        if(end - rect < width * height * LAYER_FRAME_DEPTH)
+            return false;
+        
+        // Planar just like the frame, the rows of the red, green and blue planes
+        for(unsigned int i = 0; i < LAYER_FRAME_DEPTH; ++i) {
+            dst = &frame->buffer[i * LAYER_NUM_OF_LEDS + y * LAYER_NUM_OF_COLS + x];
+            for(unsigned int j = 0; j < height; ++j) {
+                memcpy(dst, rect, width);
+                dst += LAYER_NUM_OF_COLS;
+                rect += width;
+            }
+        }
+    }
+    return true;
+}
+
+static void layer_present_frame(void)
+{
+    struct layer_frame* frame = NULL;
+    struct layer_frame* next;
+    unsigned int now = sys_core_timer();
+    bool palette = false;
+    
+    // Present the most recent frame that is due, frames before it are too late. Palettes are applied in order
+    while(layer_queue_count > 0 && (int)(now - layer_queue[layer_queue_head]->due) >= 0) {
+        next = layer_queue[layer_queue_head];
+        layer_queue_head = (layer_queue_head + 1) % LAYER_QUEUE_DEPTH;
+        layer_queue_count--;
+        
+        if(LAYER_FRAME_TYPE_PALETTE == next->type) {
+            layer_palette_apply(next);
+            layer_release_frame(next);
+            palette = true;
+            continue;
+        }
+        if(NULL != frame) {
+            layer_release_frame(frame);
+            layer_late_frames++;
+        }
+        frame = next;
+    }
+    
+    if(NULL == frame && !palette)
+        return;
+    
+    if(NULL != frame) {
+#if (LAYER_INTERPOLATION == 1)
+        // Keep the current frame to blend from
+        layer_release_frame(layer_previous_frame);
+        layer_previous_frame = layer_draw_frame;
+#else
+        layer_release_frame(layer_draw_frame);
+#endif
+        layer_draw_frame = frame;
+        layer_draw_frame->timestamp = now;
+        layer_frames++;
+    }
+    
+    // The content of an indexed frame depends on the current palette
+    if(LAYER_FRAME_TYPE_INDEXED == layer_draw_frame->type) {
+        layer_draw_frame->rows = layer_frame_rows(layer_draw_frame);
+        layer_draw_frame->load = layer_frame_load(layer_draw_frame);
+    }
+    
+    // A test pattern keeps its own load
+    if(LAYER_PATTERN_NONE == layer_pattern_shown && layer_limiter_aim(layer_draw_frame->load, layer_draw_frame->rows))
+        layer_limited_frames++;
+}
+
+static bool layer_palette_valid(const struct layer_frame* frame, unsigned int size)
+{
+    unsigned int first = frame->buffer[0];
+    unsigned int count = frame->buffer[1] ? frame->buffer[1] : LAYER_PALETTE_SIZE;
+    
+    if(size < LAYER_PALETTE_HEADER_SIZE || first + count > LAYER_PALETTE_SIZE)
+        return false;
+    return LAYER_PALETTE_HEADER_SIZE + count * LAYER_FRAME_DEPTH <= size;
+}
+
+static void layer_palette_apply(const struct layer_frame* frame)
+{
+    unsigned int first = frame->buffer[0];
+    unsigned int count = frame->buffer[1] ? frame->buffer[1] : LAYER_PALETTE_SIZE;
+    
+    memcpy(layer_palette[first], &frame->buffer[LAYER_PALETTE_HEADER_SIZE], count * LAYER_FRAME_DEPTH);
+}
+
+static void layer_sync_timebase(void)
+{
+    // The master sent its current time right at the end of the header, the ticks wrap along with the us
+    layer_timebase_offset = layer_header_received - layer_header.timestamp * LAYER_TIMEBASE_TICKS;
+    layer_timebase_synced = true;
+}
+
+static unsigned int layer_frame_rows(const struct layer_frame* frame)
+{
+#if (LAYER_SKIP_BLACK_ROWS == 1)
+    const unsigned int* red = (const unsigned int*)&frame->buffer[LAYER_RED_OFFSET];
+    const unsigned int* green = (const unsigned int*)&frame->buffer[LAYER_GREEN_OFFSET];
+    const unsigned int* blue = (const unsigned int*)&frame->buffer[LAYER_BLUE_OFFSET];
+    const unsigned int* raw = (const unsigned int*)frame->buffer;
+    unsigned int rows = 0;
+    unsigned int content;
+    
+    if(LAYER_FRAME_TYPE_INDEXED == frame->type)
+        return layer_indexed_rows(frame);
+    
+    for(unsigned int i = 0; i < LAYER_NUM_OF_ROWS; ++i) {
+        content = 0;
+        if(LAYER_FRAME_TYPE_RAW == frame->type) {
+            for(unsigned int j = 0; j < LAYER_RAW_ROW_WORDS; ++j)
+                content |= *raw++;
+        } else {
+            for(unsigned int j = 0; j < LAYER_ROW_WORDS; ++j)
+                content |= *red++ | *green++ | *blue++;
+        }
+        if(content)
+            rows |= BIT(i);
+    }
+    
+    // Bitstreams aren't remapped
+    if(LAYER_FRAME_TYPE_RAW == frame->type)
+        return rows;
+    
+    content = rows;
+    rows = 0;
+    for(unsigned int i = 0; i < LAYER_NUM_OF_ROWS; ++i) {
+        if(!layer_remap_mixed) {
+            if(content & BIT(layer_remap_rows[i]))
+                rows |= BIT(i);
+            continue;
+        }
+        
+        // Values of the row come from several source rows, check each LED
+        for(unsigned int j = 0; j < LAYER_NUM_OF_COLS; ++j) {
+            const unsigned char* led = &frame->buffer[layer_remap[i * LAYER_NUM_OF_COLS + j]];
+            if(led[LAYER_RED_OFFSET] | led[LAYER_GREEN_OFFSET] | led[LAYER_BLUE_OFFSET]) {
+                rows |= BIT(i);
+                break;
+            }
+        }
+    }
+    return rows;
+#else
+    (void)(frame);
+    return LAYER_ROW_ALL_MASK;
+#endif
+}
+
+static unsigned int layer_frame_load(const struct layer_frame* frame)
+{
+#if (LAYER_LIMITER == 1)
+    const unsigned int* word = (const unsigned int*)frame->buffer;
+    unsigned int load = 0;
+    unsigned int lanes;
+    unsigned int end;
+    
+    if(LAYER_FRAME_TYPE_INDEXED == frame->type)
+        return layer_indexed_load(frame);
+    if(LAYER_FRAME_TYPE_RGB != frame->type)
+        return 0;
+    
+    // Sum a word at a time, the even and odd bytes are added in two 16 bit lanes
+    for(unsigned int i = 0; i < LAYER_FRAME_BUFFER_WORDS; i = end) {
+        end = i + LAYER_LOAD_BATCH < LAYER_FRAME_BUFFER_WORDS ? i + LAYER_LOAD_BATCH : LAYER_FRAME_BUFFER_WORDS;
+        lanes = 0;
+        for(unsigned int j = i; j < end; ++j)
+            lanes += (word[j] & 0x00ff00ff) + ((word[j] >> 8) & 0x00ff00ff);
+        load += (lanes & 0xffff) + (lanes >> 16);
+    }
+    return load;
+#else
+    (void)(frame);
+    return 0;
+#endif
+}
+
+static unsigned int layer_indexed_rows(const struct layer_frame* frame)
+{
+    const unsigned char* entry;
+    unsigned int rows = 0;
+    
+    // Already in the orientation of the board, a row has content once any of its entries isn't black
+    for(unsigned int i = 0; i < LAYER_NUM_OF_ROWS; ++i) {
+        for(unsigned int j = 0; j < LAYER_NUM_OF_COLS; ++j) {
+            entry = layer_palette[frame->buffer[layer_remap[i * LAYER_NUM_OF_COLS + j]]];
+            if(entry[0] | entry[1] | entry[2]) {
+                rows |= BIT(i);
+                break;
+            }
+        }
+    }
+    return rows;
+}
+
+static unsigned int layer_indexed_load(const struct layer_frame* frame)
+{
+    const unsigned char* entry;
+    unsigned int load = 0;
+    
+    for(unsigned int i = 0; i < LAYER_NUM_OF_LEDS; ++i) {
+        entry = layer_palette[frame->buffer[i]];
+        load += entry[0] + entry[1] + entry[2];
+    }
+    return load;
+}
+
+static void layer_remap_build(unsigned int remap, const unsigned char* permutation)
+{
+    unsigned int row;
+    unsigned int col;
+    unsigned int source_row;
+    unsigned int source_col;
+    unsigned char* remap_row;
+    
+    for(unsigned int i = 0; i < LAYER_NUM_OF_ROWS; ++i) {
+        remap_row = &layer_remap[i * LAYER_NUM_OF_COLS];
+        for(unsigned int j = 0; j < LAYER_NUM_OF_COLS; ++j) {
+            // Channel j of row i drives this LED
+            row = i;
+            col = layer_channel_order[j];
+            if(NULL != permutation) {
+                remap_row[j] = permutation[row * LAYER_NUM_OF_COLS + col];
+                continue;
+            }
+            
+            source_row = (remap & LAYER_REMAP_TRANSPOSE) ? col : row;
+            source_col = (remap & LAYER_REMAP_TRANSPOSE) ? row : col;
+            if(remap & LAYER_REMAP_MIRROR_ROWS)
+                source_row = LAYER_NUM_OF_ROWS - 1 - source_row;
+            if(remap & LAYER_REMAP_MIRROR_COLS)
+                source_col = LAYER_NUM_OF_COLS - 1 - source_col;
+            remap_row[j] = source_row * LAYER_NUM_OF_COLS + source_col;
+        }
+    }
+    
+    // Rows that take all values from a single source row can reuse the source row mask
+    layer_remap_mixed = false;
+    for(unsigned int i = 0; i < LAYER_NUM_OF_ROWS; ++i) {
+        remap_row = &layer_remap[i * LAYER_NUM_OF_COLS];
+        layer_remap_rows[i] = remap_row[0] / LAYER_NUM_OF_COLS;
+        for(unsigned int j = 1; j < LAYER_NUM_OF_COLS; ++j) {
+            if(remap_row[j] / LAYER_NUM_OF_COLS != layer_remap_rows[i])
+                layer_remap_mixed = true;
+        }
+    }
+}
+
+static void layer_remap_frames(void)
+{
+    // The rows to refresh depend on the remap
+    layer_draw_frame->rows = layer_frame_rows(layer_draw_frame);
+#if (LAYER_INTERPOLATION == 1)
+    layer_previous_frame->rows = layer_frame_rows(layer_previous_frame);
+#endif
+    for(unsigned int i = 0; i < layer_queue_count; ++i) {
+        struct layer_frame* frame = layer_queue[(layer_queue_head + i) % LAYER_QUEUE_DEPTH];
+        frame->rows = layer_frame_rows(frame);
+    }
+}
+
+static bool layer_limiter_aim(unsigned int load, unsigned int rows)
+{
+#if (LAYER_LIMITER == 1)
+    // Average load of the rows that are refreshed
+    layer_limiter.target = LAYER_WEIGHT_MAX;
+    if(0 == rows || load / __builtin_popcount(rows) <= LAYER_LIMITER_ROW_LOAD)
+        return false;
+    
+    layer_limiter.target = (LAYER_LIMITER_ROW_LOAD * __builtin_popcount(rows) * LAYER_WEIGHT_MAX) / load;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void layer_limiter_execute(void)
+{
+#if (LAYER_LIMITER == 1)
+    // Go down quickly to stay within the budget, go up slowly to avoid pumping
+    if(layer_limiter.scale > layer_limiter.target)
+        layer_limiter.scale -= layer_limiter.scale - layer_limiter.target > LAYER_LIMITER_ATTACK ? LAYER_LIMITER_ATTACK : layer_limiter.scale - layer_limiter.target;
+    else if(layer_limiter.scale < layer_limiter.target)
+        layer_limiter.scale += layer_limiter.target - layer_limiter.scale > LAYER_LIMITER_RELEASE ? LAYER_LIMITER_RELEASE : layer_limiter.target - layer_limiter.scale;
+#endif
+}
+
+static unsigned int layer_pattern_load(unsigned int pattern, unsigned int level)
+{
+    // Sum of all values, just like layer_frame_load()
+    switch(pattern) {
+        case LAYER_PATTERN_RAMP:
+        case LAYER_PATTERN_CHECKERBOARD:    return (LAYER_NUM_OF_LEDS * LAYER_FRAME_DEPTH * level) / 2;
+        case LAYER_PATTERN_WALK:            return level;
+        case LAYER_PATTERN_CHASE_ROWS:      return LAYER_NUM_OF_COLS * LAYER_FRAME_DEPTH * level;
+        case LAYER_PATTERN_CHASE_COLS:      return LAYER_NUM_OF_ROWS * LAYER_FRAME_DEPTH * level;
+        case LAYER_PATTERN_WHITE:           return LAYER_NUM_OF_LEDS * LAYER_FRAME_DEPTH * level;
+        default:                            return 0;
+    }
+}
+
+static void layer_pattern_execute(void)
+{
+    if(LAYER_PATTERN_NONE == layer_pattern_shown)
+        return;
+    
+    // Moving patterns take a step every step time
+    if(sys_core_timer() - layer_pattern_stepped >= LAYER_PATTERN_STEP_TICKS) {
+        layer_pattern_stepped += LAYER_PATTERN_STEP_TICKS;
+        layer_pattern_position++;
+    }
+}
+
+static void layer_governor_execute(void)
+{
+#if (LAYER_GOVERNOR == 1)
+    unsigned int interval = layer_governor.interval;
+    unsigned int required;
+    
+    // Required interval to prepare, shift and latch a row in time, with some margin
+    required = SYS_CORE_TIMER_NS(layer_governor.prep + layer_governor.shift + layer_governor.lateness) / 1000;
+    required = (required * LAYER_GOVERNOR_MARGIN) / 100;
+    
+    if(layer_governor.misses > 0 || required > interval) {
+        // Back off right away
+        interval += LAYER_GOVERNOR_STEP;
+        if(required > interval)
+            interval = required;
+        layer_governor.settle = 0;
+    } else if(required + LAYER_GOVERNOR_HYSTERESIS < interval) {
+        // Only speed up once the load has been low for a while
+        if(++layer_governor.settle >= LAYER_GOVERNOR_SETTLE) {
+            interval -= LAYER_GOVERNOR_STEP;
+            layer_governor.settle = 0;
+        }
     } else
-        layer_row_io++;
+        layer_governor.settle = 0;
+    
+    if(interval < LAYER_REFRESH_INTERVAL_MIN)
+        interval = LAYER_REFRESH_INTERVAL_MIN;
+    else if(interval > LAYER_REFRESH_INTERVAL_MAX)
+        interval = LAYER_REFRESH_INTERVAL_MAX;
+    
+    if(interval != layer_governor.interval)
+        layer_governor_apply(interval);
+#endif
+    
+    layer_governor.prep = 0;
+    layer_governor.shift = 0;
+    layer_governor.lateness = 0;
+    layer_governor.misses = 0;
+}
+
+static void layer_governor_apply(unsigned int interval)
+{
+    layer_governor.interval = interval;
+    layer_governor.period = SYS_CORE_TIMER_TICKS(interval * 1000LU);
+    kernel_ttask_set_interval(layer_ttask_param, interval, KERN_TIME_UNIT_US);
+#if (LAYER_GOVERNOR == 1)
+    // A fixed interval keeps the fastest grayscale cycle
+    driver_set_cycle_time(interval);
+#endif
+}
+
+static unsigned int layer_scan_mask(void)
+{
+    // Patterns always refresh all rows, so the refresh load doesn't depend on the pattern
+    if(LAYER_PATTERN_NONE != layer_pattern_shown)
+        return LAYER_ROW_ALL_MASK;
+#if (LAYER_INTERPOLATION == 1)
+    // Rows of the previous frame still have to fade out
+    if(layer_interpolation_weight() < LAYER_WEIGHT_MAX)
+        return layer_draw_frame->rows | layer_previous_frame->rows;
+#endif
+    return layer_draw_frame->rows;
+}
+
+static void layer_scan_build(unsigned int rows)
+{
+    layer_scan_size = 0;
+    for(unsigned int i = 0; i < LAYER_NUM_OF_ROWS; ++i) {
+        if(rows & BIT(i))
+            layer_scan_rows[layer_scan_size++] = i;
+    }
+}
+
+static unsigned int layer_interpolation_weight(void)
+{
+#if (LAYER_INTERPOLATION == 1)
+    unsigned int interval = layer_draw_frame->timestamp - layer_previous_frame->timestamp;
+    unsigned int elapsed = sys_core_timer() - layer_draw_frame->timestamp;
+    
+    // Bitstreams can't be blended
+    if(LAYER_FRAME_TYPE_RGB != layer_draw_frame->type || LAYER_FRAME_TYPE_RGB != layer_previous_frame->type)
+        return LAYER_WEIGHT_MAX;
+    
+    // Show the current frame as is once blended or after a pause in between frames
+    if(elapsed >= interval || interval > LAYER_INTERPOLATION_TICKS)
+        return LAYER_WEIGHT_MAX;
+    return (elapsed << LAYER_WEIGHT_SHIFT) / interval;
+#else
+    return LAYER_WEIGHT_MAX;
+#endif
+}
+
+inline static unsigned int __attribute__((always_inline)) layer_blend(unsigned int from, unsigned int to, unsigned int weight)
+{
+    // Blend with an 8 bit weight, the result has 8 more fractional bits than the levels
+    return (from << LAYER_WEIGHT_SHIFT) + (to - from) * weight;
+}
+
+inline static unsigned int __attribute__((always_inline)) layer_level(unsigned int value, unsigned int scale)
+{
+    // Gamma corrected and scaled level in 8.8 fixed point
+    return (layer_gamma[value] * scale) >> LAYER_WEIGHT_SHIFT;
+}
+
+#if (LAYER_INTERPOLATION == 1)
+inline static unsigned int __attribute__((always_inline)) layer_blend_level(unsigned int from, unsigned int to, unsigned int weight, unsigned int scale)
+{
+    // Blend the gamma corrected levels, so a fade follows the same response as a still frame
+    return ((layer_blend(layer_gamma[from], layer_gamma[to], weight) >> LAYER_WEIGHT_SHIFT) * scale) >> LAYER_WEIGHT_SHIFT;
+}
+#endif
+
+static void layer_pack_row(unsigned int row)
+{
+    const unsigned char* buffer = layer_draw_frame->buffer;
+    unsigned int scale = layer_limiter.scale;
+#if (LAYER_INTERPOLATION == 1)
+    const unsigned char* previous = layer_previous_frame->buffer;
+    unsigned int weight = layer_interpolation_weight();
+#endif
+    
+    const unsigned char* remap = &layer_remap[row * LAYER_NUM_OF_COLS];
+    
+    for(unsigned int i = 0; i < LAYER_NUM_OF_COLS; i++) {
+        layer_offset = remap[i];
+        layer_red_index = layer_offset + LAYER_RED_OFFSET;
+        layer_green_index = layer_offset + LAYER_GREEN_OFFSET;
+        layer_blue_index = layer_offset + LAYER_BLUE_OFFSET;
+
+#if (LAYER_INTERPOLATION == 1)
+        driver_write_grayscale(0, i, layer_blend_level(previous[layer_red_index], buffer[layer_red_index], weight, scale));
+        driver_write_grayscale(1, i, layer_blend_level(previous[layer_green_index], buffer[layer_green_index], weight, scale));
+        driver_write_grayscale(2, i, layer_blend_level(previous[layer_blue_index], buffer[layer_blue_index], weight, scale));
+#else
+        driver_write_grayscale(0, i, layer_level(buffer[layer_red_index], scale));
+        driver_write_grayscale(1, i, layer_level(buffer[layer_green_index], scale));
+        driver_write_grayscale(2, i, layer_level(buffer[layer_blue_index], scale));
+#endif
+    }
+}
+
+inline static unsigned int __attribute__((always_inline)) layer_pattern_value(unsigned int led, unsigned int color)
+{
+    unsigned int row = led / LAYER_NUM_OF_COLS;
+    unsigned int col = led % LAYER_NUM_OF_COLS;
+    unsigned int position = layer_pattern_position;
+    
+    switch(layer_pattern_shown) {
+        case LAYER_PATTERN_RAMP:            return (led + position) & 0xff; // Every level once in each color
+        case LAYER_PATTERN_CHECKERBOARD:    return (row ^ col ^ position) & 1 ? 0xff : 0;
+        case LAYER_PATTERN_WALK:            return color * LAYER_NUM_OF_LEDS + led == position % (LAYER_NUM_OF_LEDS * LAYER_FRAME_DEPTH) ? 0xff : 0;
+        case LAYER_PATTERN_CHASE_ROWS:      return row == position % LAYER_NUM_OF_ROWS ? 0xff : 0;
+        case LAYER_PATTERN_CHASE_COLS:      return col == position % LAYER_NUM_OF_COLS ? 0xff : 0;
+        case LAYER_PATTERN_WHITE:           return 0xff;
+        default:                            return 0;
+    }
+}
+
+static void layer_pack_pattern(unsigned int row)
+{
+    const unsigned char* remap = &layer_remap[row * LAYER_NUM_OF_COLS];
+    unsigned int scale = layer_limiter.scale * layer_pattern_level;
+    
+    // Generated in the orientation of the board, so the walk and chases verify the remap as well
+    for(unsigned int i = 0; i < LAYER_NUM_OF_COLS; i++) {
+        for(unsigned int j = 0; j < LAYER_FRAME_DEPTH; j++)
+            driver_write_grayscale(j, i, (layer_pattern_value(remap[i], j) * scale) >> LAYER_WEIGHT_SHIFT);
+    }
+}
+
+static void layer_pack_indexed(unsigned int row)
+{
+    const unsigned char* buffer = layer_draw_frame->buffer;
+    const unsigned char* remap = &layer_remap[row * LAYER_NUM_OF_COLS];
+    const unsigned char* entry;
+    unsigned int scale = layer_limiter.scale;
+    
+    // Expand each index through the palette, gamma corrected just like an RGB frame
+    for(unsigned int i = 0; i < LAYER_NUM_OF_COLS; i++) {
+        entry = layer_palette[buffer[remap[i]]];
+        driver_write_grayscale(0, i, layer_level(entry[0], scale));
+        driver_write_grayscale(1, i, layer_level(entry[1], scale));
+        driver_write_grayscale(2, i, layer_level(entry[2], scale));
+    }
 }
 
 static int layer_ttask_init(void)
 {
-    const struct layer_io* io = NULL;
+    unsigned int portd = 0;
+    unsigned int porte = 0;
+    unsigned int interval;
+    unsigned int dead_time;
+    unsigned char remap;
+    unsigned char address;
     
-    // Initialize IO
+    // The row table and the port masks must describe the same pins
     for(unsigned int i = 0; i < LAYER_NUM_OF_ROWS; ++i) {
-        io = &layer_io[i];
-        if(NULL != io->ansel)
-            atomic_reg_ptr_clr(io->ansel, io->mask);
-        atomic_reg_ptr_clr(io->tris, io->mask);
-        atomic_reg_ptr_clr(io->lat, io->mask);
+        portd |= layer_rows[i].portd;
+        porte |= layer_rows[i].porte;
+    }
+    ASSERT(portd == LAYER_ROW_PORTD_MASK);
+    ASSERT(porte == LAYER_ROW_PORTE_MASK);
+    
+    // Initialize IO
+    atomic_reg_ptr_clr(LAYER_ROW_ANSELD, LAYER_ROW_PORTD_MASK);
+    atomic_reg_ptr_clr(LAYER_ROW_ANSELE, LAYER_ROW_PORTE_MASK);
+    atomic_reg_ptr_clr(LAYER_ROW_TRISD, LAYER_ROW_PORTD_MASK);
+    atomic_reg_ptr_clr(LAYER_ROW_TRISE, LAYER_ROW_PORTE_MASK);
+    atomic_reg_ptr_clr(LAYER_ROW_LATD, LAYER_ROW_PORTD_MASK);
+    atomic_reg_ptr_clr(LAYER_ROW_LATE, LAYER_ROW_PORTE_MASK);
+    
+    // Initialize frames, all but the reserved frames are free
+    for(unsigned int i = LAYER_FRAME_COUNT; i > LAYER_FRAME_RESERVED; --i)
+        layer_release_frame(&layer_frame_pool[i - 1]);
+    
+    // Initialize palette, a gray ramp until the first palette is presented
+    for(unsigned int i = 0; i < LAYER_PALETTE_SIZE; ++i)
+        memset(layer_palette[i], i, LAYER_FRAME_DEPTH);
+    
+    // Initialize gamma table, a linear response unless stored
+    if(!store_get(STORE_KEY_GAMMA, layer_gamma, sizeof(layer_gamma))) {
+        for(unsigned int i = 0; i < LAYER_GAMMA_SIZE; ++i)
+            layer_gamma[i] = i << LAYER_WEIGHT_SHIFT;
     }
     
-    // Initialize TLC5940
-    tlc5940_set_latch_callback(layer_latch_callback);
+    // Initialize row dead-time, the configured dead-time unless stored
+    if(store_get(STORE_KEY_DEAD_TIME, &dead_time, sizeof(dead_time)) && dead_time <= LAYER_DEAD_TIME_MAX)
+        layer_dead_time_ticks = SYS_CORE_TIMER_TICKS(dead_time);
+    
+    // Initialize board address
+    if(store_get(STORE_KEY_BOARD_ADDRESS, &address, sizeof(address)) && address < LAYER_NUM_OF_ADDRESSES)
+        layer_address = address;
+    
+    // Initialize remap, a free frame holds the stored permutation for a moment
+    remap = LAYER_REMAP;
+    store_get(STORE_KEY_REMAP, &remap, sizeof(remap));
+    layer_remap_orientation = remap & LAYER_REMAP_MASK;
+    layer_remap_build(layer_remap_orientation, (remap & LAYER_REMAP_PERMUTED)
+        && store_get(STORE_KEY_PERMUTATION, layer_free_frames[0]->buffer, LAYER_NUM_OF_LEDS) ? layer_free_frames[0]->buffer : NULL);
+#if (LAYER_BOOT_FRAME == 1)
+    ASSERT(sizeof(layer_boot_frame) == LAYER_FRAME_BUFFER_SIZE);
+    memcpy(layer_draw_frame->buffer, layer_boot_frame, LAYER_FRAME_BUFFER_SIZE);
+    layer_draw_frame->type = LAYER_FRAME_TYPE_RGB;
+#endif
+    layer_draw_frame->rows = layer_frame_rows(layer_draw_frame);
+    layer_draw_frame->load = layer_frame_load(layer_draw_frame);
+    
+#if (LAYER_PATTERN_JUMPER == 1)
+    // Initialize test jumper, a fitted jumper pulls the pin low
+    REG_CLR(LAYER_JUMPER_ANSEL, LAYER_JUMPER_PIN_MASK);
+    REG_SET(LAYER_JUMPER_TRIS, LAYER_JUMPER_PIN_MASK);
+    REG_SET(LAYER_JUMPER_CNPU, LAYER_JUMPER_PIN_MASK);
+    sys_core_timer_wait(sys_core_timer(), LAYER_JUMPER_SETTLE_TICKS);
+    if(!(LAYER_JUMPER_PORT & LAYER_JUMPER_PIN_MASK))
+        layer_set_pattern(LAYER_JUMPER_PATTERN, LAYER_JUMPER_LEVEL);
+#endif
+    
+    // Initialize LED driver, blank while the CPU stalls on flash operations
+    driver_set_latch_callback(layer_latch_callback);
+    nvm_set_stall_callback(layer_blank);
+    
+    // Initialize refresh interval, a stored interval overrides the configured interval
+    if(!store_get(STORE_KEY_REFRESH_INTERVAL, &interval, sizeof(interval))
+        || interval < LAYER_REFRESH_INTERVAL_MIN || interval > LAYER_REFRESH_INTERVAL_MAX)
+        interval = LAYER_REFRESH_INTERVAL;
+    layer_governor_apply(interval);
     
     return KERN_INIT_SUCCCES;
 }
 
 static void layer_ttask_execute(void)
 {    
-    if(tlc5940_ready()) {
-        layer_offset = layer_row_index * LAYER_NUM_OF_COLS;
-        for(unsigned int i = 0; i < LAYER_NUM_OF_COLS; i++) {
-            // Convert 8 bit to 12 bit equivalent
-            layer_red_index = i + layer_offset + LAYER_RED_OFFSET;
-            layer_green_index = i + layer_offset + LAYER_GREEN_OFFSET;
-            layer_blue_index = i + layer_offset + LAYER_BLUE_OFFSET;
+    unsigned int begin = sys_core_timer();
+    unsigned int lateness = begin - layer_governor.released - layer_governor.period;
+    
+    // Release lateness, an early release shows up as a huge unsigned lateness and is ignored
+    layer_governor.released = begin;
+    if(lateness < SYS_CORE_TIMER_TICKS(LAYER_REFRESH_INTERVAL_MAX * 1000LU) && lateness > layer_governor.lateness)
+        layer_governor.lateness = lateness;
+    
+    if(driver_ready()) {
+        // Start of a new scan, present the next frame once due and pick up its rows
+        if(0 == layer_scan_index) {
+            layer_present_frame();
+            layer_pattern_execute();
+            layer_limiter_execute();
+            layer_governor_execute();
+            layer_scan_build(layer_scan_mask());
+        }
+        
+        if(layer_scan_size > 0) {
+            layer_row_index = layer_scan_rows[layer_scan_index];
+            if(LAYER_PATTERN_NONE != layer_pattern_shown)
+                layer_pack_pattern(layer_row_index);
+            else if(LAYER_FRAME_TYPE_INDEXED == layer_draw_frame->type)
+                layer_pack_indexed(layer_row_index);
+            else if(LAYER_FRAME_TYPE_RAW != layer_draw_frame->type)
+                layer_pack_row(layer_row_index);
+            
+            layer_governor.updated = sys_core_timer();
+            if(layer_governor.updated - begin > layer_governor.prep)
+                layer_governor.prep = layer_governor.updated - begin;
+            if(layer_governor.prep > layer_pack_measured)
+                layer_pack_measured = layer_governor.prep;
             
-            tlc5940_write_grayscale(0, i, (layer_dma_ptr[layer_red_index] << 4) | (layer_dma_ptr[layer_red_index] >> 4));
-            tlc5940_write_grayscale(1, i, (layer_dma_ptr[layer_green_index] << 4) | (layer_dma_ptr[layer_green_index] >> 4));
-            tlc5940_write_grayscale(2, i, (layer_dma_ptr[layer_blue_index] << 4) | (layer_dma_ptr[layer_blue_index] >> 4));
+            // A bitstream is streamed straight from the frame, without packing
+            if(LAYER_PATTERN_NONE == layer_pattern_shown && LAYER_FRAME_TYPE_RAW == layer_draw_frame->type)
+                driver_update_raw(&layer_draw_frame->buffer[layer_row_index * LAYER_RAW_ROW_SIZE], LAYER_RAW_ROW_SIZE);
+            else
+                driver_update();
+        } else if(layer_row_lit) {
+            // Nothing to refresh, latch in an empty row once to switch off the last lit row
+            layer_row_index = LAYER_ROW_NONE;
+            layer_governor.updated = sys_core_timer();
+            driver_update();
         }
-        tlc5940_update();
+    } else {
+        // The previous row is still being shifted or latched
+        layer_governor.misses++;
+        layer_deadline_misses++;
     }
 }
 
 static void layer_ttask_configure(struct kernel_ttask_param* const param)
 {
+    layer_ttask_param = param;
     kernel_ttask_set_priority(param, KERN_TTASK_PRIORITY_HIGH);
     kernel_ttask_set_interval(param, LAYER_REFRESH_INTERVAL, KERN_TIME_UNIT_US);
+    kernel_ttask_set_budget(param, LAYER_TTASK_BUDGET, KERN_TIME_UNIT_US);
+}
+
+static void layer_rtask_configure(struct kernel_rtask_param* const param)
+{
+    // Sleep until a frame receive is requested
+    layer_rtask_param = param;
+    kernel_rtask_wait(param, &layer_events, LAYER_EVENT_RECEIVE);
 }
  
 static int layer_rtask_init(void)
@@ -240,17 +1508,72 @@ static void layer_rtask_execute(void)
         case LAYER_IDLE:
             break;
         case LAYER_RECEIVE_FRAME:
+            // Keep running until the DMA is armed
+            kernel_event_take(&layer_events, LAYER_EVENT_RECEIVE);
+            kernel_rtask_wait(layer_rtask_param, NULL, 0);
+            layer_state = LAYER_RECEIVE_FRAME_DMA_START;
+            // no break
         case LAYER_RECEIVE_FRAME_DMA_START:
             // @Todo: add timeout timer
             if(dma_ready(layer_dma_channel)) {
-                dma_configure_dst(layer_dma_channel, layer_dma_ptr, LAYER_FRAME_BUFFER_SIZE);
+                // Data that arrived while not receiving is lost as well
+                if(spi_receive_overflow(layer_spi_module))
+                    layer_overruns++;
+                
+                // Frames are only released at the start of a scan, while the driver isn't streaming from them
+                if(NULL == layer_dma_frame)
+                    layer_dma_frame = layer_acquire_frame();
+                
+                // Receive the header first, the payload is received once the header is known
+                layer_receive_phase = LAYER_RECEIVE_HEADER;
+                dma_configure_dst(layer_dma_channel, &layer_header, sizeof(layer_header));
+#if (LAYER_CRC == 1)
+                dma_crc_reset(layer_dma_channel);
+#endif
                 dma_enable_transfer(layer_dma_channel);
+                kernel_rtask_wait(layer_rtask_param, &layer_events, LAYER_EVENT_RECEIVED);
                 layer_state = LAYER_RECEIVE_FRAME_DMA_WAIT;
             }
             break;
         case LAYER_RECEIVE_FRAME_DMA_WAIT:
-            if(dma_ready(layer_dma_channel))
+            // Only dispatched once the DMA finished, then sleep until the next receive request
+            kernel_event_take(&layer_events, LAYER_EVENT_RECEIVED);
+            kernel_rtask_wait(layer_rtask_param, &layer_events, LAYER_EVENT_RECEIVE);
+            if(LAYER_RECEIVE_INVALID == layer_receive_phase) {
+                layer_header_errors++;
                 layer_state = LAYER_IDLE;
+            } else if(LAYER_RECEIVE_DONE == layer_receive_phase) {
+#if (LAYER_SWAP_WORDS == 1)
+                layer_swap_words(LAYER_FRAME_TYPE_RECT == layer_header.type
+                    ? &layer_dma_frame->buffer[LAYER_RECT_OFFSET] : layer_dma_frame->buffer, layer_header.size);
+#endif
+                if(spi_receive_overflow(layer_spi_module))
+                    layer_overruns++; // Frame is incomplete
+                else
+#if (LAYER_CRC == 1)
+                // Remainder over the header, the frame and its trailer is zero for an intact frame
+                if(0 != dma_crc_result(layer_dma_channel))
+                    layer_crc_errors++;
+                else
+#endif
+                if((layer_header.flags & LAYER_FRAME_FLAG_ADDRESSED) && LAYER_FRAME_ADDRESS(layer_header.flags) != layer_address)
+                    layer_foreign_frames++; // For another board on the shared bus
+                else if(LAYER_FRAME_TYPE_SYNC == layer_header.type)
+                    layer_sync_timebase();
+                else if(LAYER_FRAME_TYPE_PATTERN == layer_header.type) {
+                    if(!layer_set_pattern(layer_dma_frame->buffer[0], layer_dma_frame->buffer[1]))
+                        layer_header_errors++;
+                } else if(LAYER_FRAME_TYPE_DRAW == layer_header.type) {
+                    if(!render_submit(layer_dma_frame->buffer, layer_header.size))
+                        layer_render_rejects++; // Still rendering the previous commands
+                } else if(LAYER_FRAME_TYPE_PALETTE == layer_header.type && !layer_palette_valid(layer_dma_frame, layer_header.size))
+                    layer_header_errors++; // Entries beyond the palette or truncated
+                else if(LAYER_FRAME_TYPE_RECT == layer_header.type && !layer_blit_rects())
+                    layer_header_errors++; // Rectangle out of bounds or truncated
+                else
+                    layer_queue_frame();
+                layer_state = LAYER_IDLE;
+            }
             break;
     }
 }
\ No newline at end of file
@@ -3,12 +3,21 @@
 #include "../include/kernel_task.h"
 #include "../include/dma.h"
 #include "../include/pwm.h"
+#include "../include/stack.h"
+#include "../include/firmware.h"
+#include "../include/firmware_config.h"
+#include "../include/driver.h"
 
 int main()
 {    
+    // Count the uptime from here on, the core timer isn't cleared by every reset
+    sys_core_timer_clear();
+    
     // Bonzo is sleeping for the early init
     sys_goodnight_bonzo();
     sys_disable_global_interrupt();
+    driver_early_init();
+    stack_paint();
     sys_cpu_early_init();
     
     // Initialize other stuff
@@ -18,6 +27,11 @@ int main()
     kernel_init();
     sys_enable_global_interrupt();
     
+#if (FIRMWARE_UPDATE == 1)
+    // Made it this far, so the bootloader doesn't have to fall back to the other slot
+    firmware_confirm();
+#endif
+    
     // Wakeup bonzo
     sys_wakeup_bonzo();
     
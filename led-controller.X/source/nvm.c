@@ -0,0 +1,112 @@
+#include "../include/nvm.h"
+#include "../include/sys.h"
+#include "../include/toolbox.h"
+#include <stddef.h>
+#include <xc.h>
+
+#define NVM_NVMCON_REG                  NVMCON
+#define NVM_NVMKEY_REG                  NVMKEY
+#define NVM_NVMADDR_REG                 NVMADDR
+#define NVM_NVMDATA_REG                 NVMDATA
+#define NVM_NVMSRCADDR_REG              NVMSRCADDR
+
+#define NVM_NVMCON_WR_MASK              BIT(15)
+#define NVM_NVMCON_WREN_MASK            BIT(14)
+#define NVM_NVMCON_ERROR_MASK           MASK(0x3, 12) // WRERR and LVDERR
+#define NVM_NVMCON_NVMOP_MASK           MASK(0xf, 0)
+
+#define NVM_NVMOP_WORD_PROGRAM          0x1
+#define NVM_NVMOP_ROW_PROGRAM           0x3
+#define NVM_NVMOP_PAGE_ERASE            0x4
+
+#define NVM_LVD_STARTUP_TICKS           SYS_CORE_TIMER_TICKS(6000) // Low voltage detect startup time after setting WREN
+
+static bool nvm_start(unsigned int op, unsigned int address);
+static void nvm_stall_callback_dummy(bool stall);
+
+static void (*nvm_stall_callback)(bool stall) = &nvm_stall_callback_dummy;
+static bool nvm_failed = false;
+static bool nvm_stalling = false;
+
+bool nvm_busy(void)
+{
+    if(NVM_NVMCON_REG & NVM_NVMCON_WR_MASK)
+        return true;
+    
+    // Operation finished, disable further writes
+    if(NVM_NVMCON_REG & NVM_NVMCON_WREN_MASK) {
+        nvm_failed = !!(NVM_NVMCON_REG & NVM_NVMCON_ERROR_MASK);
+        REG_CLR(NVM_NVMCON_REG, NVM_NVMCON_WREN_MASK);
+    }
+    if(nvm_stalling) {
+        nvm_stalling = false;
+        nvm_stall_callback(false);
+    }
+    return false;
+}
+
+bool nvm_error(void)
+{
+    return !nvm_busy() && nvm_failed;
+}
+
+bool nvm_erase_page(unsigned int address)
+{
+    return nvm_start(NVM_NVMOP_PAGE_ERASE, address & ~(NVM_PAGE_SIZE - 1));
+}
+
+bool nvm_write_word(unsigned int address, unsigned int word)
+{
+    if(nvm_busy())
+        return false;
+    
+    NVM_NVMDATA_REG = word;
+    return nvm_start(NVM_NVMOP_WORD_PROGRAM, address);
+}
+
+bool nvm_write_row(unsigned int address, const void* data)
+{
+    if(nvm_busy())
+        return false;
+    
+    // The data is read from RAM by the flash controller during the operation, keep it untouched until done
+    NVM_NVMSRCADDR_REG = NVM_PHY_ADDR(data);
+    return nvm_start(NVM_NVMOP_ROW_PROGRAM, address & ~(NVM_ROW_SIZE - 1));
+}
+
+void nvm_set_stall_callback(void (*callback)(bool stall))
+{
+    nvm_stall_callback = NULL != callback ? callback : &nvm_stall_callback_dummy;
+}
+
+static bool nvm_start(unsigned int op, unsigned int address)
+{
+    unsigned int status;
+    
+    if(nvm_busy())
+        return false;
+    
+    NVM_NVMADDR_REG = NVM_PHY_ADDR(address);
+    NVM_NVMCON_REG = NVM_NVMCON_WREN_MASK | (op & NVM_NVMCON_NVMOP_MASK);
+    sys_core_timer_wait(sys_core_timer(), NVM_LVD_STARTUP_TICKS);
+    
+    // A word program only stalls for a few us
+    nvm_stalling = NVM_NVMOP_WORD_PROGRAM != op;
+    if(nvm_stalling)
+        nvm_stall_callback(true);
+    
+    // The unlock sequence must not be interrupted
+    status = sys_suspend_global_interrupt();
+    NVM_NVMKEY_REG = 0xAA996655;
+    NVM_NVMKEY_REG = 0x556699AA;
+    REG_SET(NVM_NVMCON_REG, NVM_NVMCON_WR_MASK);
+    sys_resume_global_interrupt(status);
+    
+    nvm_failed = false;
+    return true;
+}
+
+static void nvm_stall_callback_dummy(bool stall)
+{
+    // Do nothing
+}
\ No newline at end of file
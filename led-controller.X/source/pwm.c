@@ -1,7 +1,9 @@
 #include "../include/pwm.h"
 #include "../include/assert.h"
+#include "../include/interrupt.h"
 #include "../include/register.h"
 #include "../include/sys.h"
+#include "../include/stack.h"
 #include "../include/toolbox.h"
 #include <xc.h>
 #include <stdbool.h>
@@ -31,8 +33,10 @@
 #define PWM_OC_OCCON_ON_MASK                BIT(15)
 
 // Below are the timer related defines
-#define PWM_TMR_PR(frequency, div)          ((SYS_PB_CLOCK * div) / (frequency * PWM_TMR_PRESCALER) - 1)
-#define PWM_TMR_PRESCALER                   256
+#define PWM_TMR_PR(oc_pr, div, prescaler)   ((((oc_pr) + 1) * PWM_OC_PRESCALER * (div)) / (prescaler) - 1) // Whole OC periods, so it doesn't drift
+#define PWM_TMR_PR_MAX                      0xffff
+#define PWM_TMR_NS(ticks)                   ((unsigned int)((1000000000LLU * (ticks)) / SYS_PB_CLOCK))
+#define PWM_TMR_PRESCALER_COUNT             (sizeof(pwm_tmr_prescalers) / sizeof(pwm_tmr_prescalers[0]))
 
 #define PWM_TMR_VECTOR                      _TIMER_3_VECTOR
 
@@ -44,15 +48,23 @@
 #define PWM_TMR_IPC_REG                     IPC3
 
 #define PWM_TMR_TCON_WORD                   MASK(0x7, 4)
+#define PWM_TMR_TCON_TCKPS_SHIFT            4
 
 #define PWM_TMR_OCCON_ON_MASK               BIT(15)
 #define PWM_TMR_INT_MASK                    BIT(14)
-#define PWM_TMR_INT_PRIORITY_MASK           MASK(0x3, 2)
+#define PWM_TMR_INT_PRIORITY_MASK           MASK(INT_IPC_MASK, 0)
+#define PWM_TMR_INT_PRIORITY_WORD           MASK(INT_IPC(INT_PWM_PRIORITY, INT_PWM_SUBPRIORITY), 0)
 
 static void pwm_period_callback_dummy(void);
 
 static void (*pwm_period_callback)(void) = &pwm_period_callback_dummy;
 
+// Prescalers of the timer, the index is the TCKPS value
+static const unsigned short pwm_tmr_prescalers[] = { 1, 2, 4, 8, 16, 32, 64, 256 };
+static unsigned short pwm_tmr_prescaler = 256;
+static volatile unsigned int pwm_latency = 0;
+static volatile unsigned int pwm_latency_max = 0;
+
 void pwm_init(void)
 {
     // Configure PPS
@@ -66,7 +78,8 @@ void pwm_init(void)
     
     // Configure interrupt
     REG_SET(PWM_TMR_IEC_REG, PWM_TMR_INT_MASK);
-    REG_SET(PWM_TMR_IPC_REG, PWM_TMR_INT_PRIORITY_MASK);
+    REG_CLR(PWM_TMR_IPC_REG, PWM_TMR_INT_PRIORITY_MASK);
+    REG_SET(PWM_TMR_IPC_REG, PWM_TMR_INT_PRIORITY_WORD);
 
     // Configure timers
     PWM_OC_TCON_REG = PWM_OC_TCON_WORD;
@@ -78,6 +91,8 @@ void pwm_init(void)
 
 void pwm_configure(struct pwm_config config)
 {
+    unsigned int prescaler;
+    
     ASSERT(config.duty >= 0.0 && config.duty <= 1.0);
     ASSERT(config.period_callback_div > 0);
     
@@ -90,8 +105,14 @@ void pwm_configure(struct pwm_config config)
     PWM_OC_OCRS_REG = PWM_OC_DUTY(config.frequency, config.duty);
     PWM_OC_OCR_REG = 0;
     
-    // Configure timer
-    PWM_TMR_PR_REG = PWM_TMR_PR(config.frequency, config.period_callback_div);
+    // Configure timer, the finest prescaler that fits the period also gives the finest latency measurement
+    for(prescaler = 0; prescaler < PWM_TMR_PRESCALER_COUNT - 1; ++prescaler) {
+        if(PWM_TMR_PR(PWM_OC_PR_REG, config.period_callback_div, pwm_tmr_prescalers[prescaler]) <= PWM_TMR_PR_MAX)
+            break;
+    }
+    pwm_tmr_prescaler = pwm_tmr_prescalers[prescaler];
+    PWM_TMR_TCON_REG = MASK(prescaler, PWM_TMR_TCON_TCKPS_SHIFT);
+    PWM_TMR_PR_REG = PWM_TMR_PR(PWM_OC_PR_REG, config.period_callback_div, pwm_tmr_prescaler);
     pwm_period_callback = &pwm_period_callback_dummy;
     
     if(NULL != config.period_callback)
@@ -116,13 +137,34 @@ void pwm_disable(void)
     REG_CLR(PWM_OC_OCCON_REG, PWM_OC_OCCON_ON_MASK);
 }
 
+struct pwm_statistics pwm_statistics(void)
+{
+    struct pwm_statistics statistics =
+    {
+        .latency = PWM_TMR_NS(pwm_latency),
+        .latency_max = PWM_TMR_NS(pwm_latency_max),
+        .resolution = PWM_TMR_NS(pwm_tmr_prescaler),
+    };
+    
+    return statistics;
+}
+
 static void pwm_period_callback_dummy(void)
 {
     // Do nothing
 }
 
-void __ISR(PWM_TMR_VECTOR, IPL7AUTO) pwm_timer_interrupt(void)
+void __ISR(PWM_TMR_VECTOR, INT_IPL(INT_PWM_PRIORITY)) pwm_timer_interrupt(void)
 {
+    // The timer restarted from zero when the interrupt was raised, so it holds the entry latency
+    unsigned int latency = PWM_TMR_TMR_REG * pwm_tmr_prescaler;
+    
+    pwm_latency = latency;
+    if(latency > pwm_latency_max)
+        pwm_latency_max = latency;
+    
+    stack_isr_enter(STACK_ISR_PWM);
     pwm_period_callback();
     REG_CLR(PWM_TMR_IFS_REG, PWM_TMR_INT_MASK);
+    stack_isr_exit();
 }
\ No newline at end of file
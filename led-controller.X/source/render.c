@@ -0,0 +1,224 @@
+#include "../include/render.h"
+#include "../include/render_config.h"
+#include "../include/render_font.h"
+#include "../include/render_sprites.h"
+#include "../include/layer.h"
+#include "../include/kernel_task.h"
+#include "../include/toolbox.h"
+#include <stddef.h>
+#include <string.h>
+
+#if !defined(RENDER_COMMAND_SIZE) || (RENDER_COMMAND_SIZE < 1)
+    #error "Render command size is not specified, please define 'RENDER_COMMAND_SIZE'"
+#endif
+
+#define RENDER_CHAR_ADVANCE         (RENDER_FONT_WIDTH + 1) // Character and spacing
+#define RENDER_COLOR_SIZE           3
+#define RENDER_CLEAR_SIZE           RENDER_COLOR_SIZE
+#define RENDER_TEXT_SIZE            (2 + RENDER_COLOR_SIZE + 1) // Excluding the characters
+#define RENDER_SCROLL_SIZE          2
+#define RENDER_SPRITE_ARG_SIZE      (3 + RENDER_COLOR_SIZE)
+#define RENDER_NUM_OF_SPRITES       (sizeof(render_sprites) / sizeof(render_sprites[0]))
+
+enum render_state
+{
+    RENDER_IDLE = 0,
+    RENDER_BEGIN,
+    RENDER_EXECUTE,
+};
+
+struct render_text
+{
+    int x;
+    int y;
+    const unsigned char* color;
+    const unsigned char* characters;
+    unsigned int length;
+};
+
+static bool render_command(void);
+static void render_character(void);
+static void render_mask(int x, int y, unsigned int column, const unsigned char* color);
+static void render_scroll(int dx, int dy);
+inline static void __attribute__((always_inline)) render_led(int x, int y, const unsigned char* color);
+
+static void render_rtask_execute(void);
+KERN_QUICK_RTASK(render, NULL, render_rtask_execute);
+
+static enum render_state render_state = RENDER_IDLE;
+static unsigned char render_commands[RENDER_COMMAND_SIZE];
+static unsigned int render_size = 0;
+static unsigned int render_index = 0; // Next command
+static unsigned char* render_canvas = NULL;
+static struct render_text render_text; // String that is being rendered
+
+bool render_busy(void)
+{
+    return render_state != RENDER_IDLE;
+}
+
+bool render_ready(void)
+{
+    return !render_busy();
+}
+
+bool render_submit(const unsigned char* commands, unsigned int size)
+{
+    if(render_busy())
+        return false;
+    if(size > RENDER_COMMAND_SIZE)
+        return false;
+    
+    memcpy(render_commands, commands, size);
+    render_size = size;
+    render_index = 0;
+    render_text.length = 0;
+    render_state = RENDER_BEGIN;
+    return true;
+}
+
+static bool render_command(void)
+{
+    const unsigned char* command = &render_commands[render_index];
+    unsigned int available = render_size - render_index;
+    
+    // An unknown or truncated command ends the commands as well
+    if(0 == available)
+        return false;
+    available--;
+    
+    switch(command[0]) {
+        case RENDER_COMMAND_CLEAR:
+            if(available < RENDER_CLEAR_SIZE)
+                return false;
+            memset(&render_canvas[LAYER_RED_OFFSET], command[1], LAYER_NUM_OF_LEDS);
+            memset(&render_canvas[LAYER_GREEN_OFFSET], command[2], LAYER_NUM_OF_LEDS);
+            memset(&render_canvas[LAYER_BLUE_OFFSET], command[3], LAYER_NUM_OF_LEDS);
+            render_index += 1 + RENDER_CLEAR_SIZE;
+            return true;
+        case RENDER_COMMAND_TEXT:
+            if(available < RENDER_TEXT_SIZE || available - RENDER_TEXT_SIZE < command[6])
+                return false;
+            render_text.x = (signed char)command[1];
+            render_text.y = (signed char)command[2];
+            render_text.color = &command[3];
+            render_text.length = command[6];
+            render_text.characters = &command[7];
+            render_index += 1 + RENDER_TEXT_SIZE + command[6];
+            return true;
+        case RENDER_COMMAND_SCROLL:
+            if(available < RENDER_SCROLL_SIZE)
+                return false;
+            render_scroll((signed char)command[1], (signed char)command[2]);
+            render_index += 1 + RENDER_SCROLL_SIZE;
+            return true;
+        case RENDER_COMMAND_SPRITE:
+            if(available < RENDER_SPRITE_ARG_SIZE)
+                return false;
+            if(command[1] < RENDER_NUM_OF_SPRITES) {
+                for(unsigned int i = 0; i < RENDER_SPRITE_SIZE; ++i) {
+                    for(unsigned int j = 0; j < RENDER_SPRITE_SIZE; ++j) {
+                        if(render_sprites[command[1]][i] & (0x80 >> j))
+                            render_led((signed char)command[2] + j, (signed char)command[3] + i, &command[4]);
+                    }
+                }
+            }
+            render_index += 1 + RENDER_SPRITE_ARG_SIZE;
+            return true;
+        case RENDER_COMMAND_END:
+        default:
+            return false;
+    }
+}
+
+static void render_character(void)
+{
+    unsigned int character = *render_text.characters;
+    
+    if(character < RENDER_FONT_FIRST || character > RENDER_FONT_LAST)
+        character = '?';
+    
+    // Characters outside the layer are skipped, the rest of the string is outside as well once past the right edge
+    if(render_text.x >= LAYER_NUM_OF_COLS)
+        render_text.length = 0;
+    else {
+        if(render_text.x > -RENDER_FONT_WIDTH) {
+            for(unsigned int i = 0; i < RENDER_FONT_WIDTH; ++i)
+                render_mask(render_text.x + i, render_text.y, render_font[character - RENDER_FONT_FIRST][i], render_text.color);
+        }
+        render_text.x += RENDER_CHAR_ADVANCE;
+        render_text.characters++;
+        render_text.length--;
+    }
+}
+
+static void render_mask(int x, int y, unsigned int column, const unsigned char* color)
+{
+    for(unsigned int i = 0; i < RENDER_FONT_HEIGHT; ++i) {
+        if(column & BIT(i))
+            render_led(x, y + i, color);
+    }
+}
+
+static void render_scroll(int dx, int dy)
+{
+    unsigned char* plane;
+    int x;
+    int y;
+    int source_x;
+    int source_y;
+    
+    // Walk against the direction of the move, so every LED is read before it is overwritten
+    for(unsigned int i = 0; i < RENDER_COLOR_SIZE; ++i) {
+        plane = &render_canvas[i * LAYER_NUM_OF_LEDS];
+        for(int j = 0; j < LAYER_NUM_OF_ROWS; ++j) {
+            y = dy > 0 ? LAYER_NUM_OF_ROWS - 1 - j : j;
+            source_y = y - dy;
+            for(int k = 0; k < LAYER_NUM_OF_COLS; ++k) {
+                x = dx > 0 ? LAYER_NUM_OF_COLS - 1 - k : k;
+                source_x = x - dx;
+                if(source_x < 0 || source_x >= LAYER_NUM_OF_COLS || source_y < 0 || source_y >= LAYER_NUM_OF_ROWS)
+                    plane[y * LAYER_NUM_OF_COLS + x] = 0;
+                else
+                    plane[y * LAYER_NUM_OF_COLS + x] = plane[source_y * LAYER_NUM_OF_COLS + source_x];
+            }
+        }
+    }
+}
+
+inline static void __attribute__((always_inline)) render_led(int x, int y, const unsigned char* color)
+{
+    unsigned int led;
+    
+    if((unsigned int)x >= LAYER_NUM_OF_COLS || (unsigned int)y >= LAYER_NUM_OF_ROWS)
+        return;
+    
+    led = y * LAYER_NUM_OF_COLS + x;
+    render_canvas[LAYER_RED_OFFSET + led] = color[0];
+    render_canvas[LAYER_GREEN_OFFSET + led] = color[1];
+    render_canvas[LAYER_BLUE_OFFSET + led] = color[2];
+}
+
+static void render_rtask_execute(void)
+{
+    switch(render_state) {
+        default:
+        case RENDER_IDLE:
+            break;
+        case RENDER_BEGIN:
+            render_canvas = layer_canvas_begin();
+            if(NULL != render_canvas)
+                render_state = RENDER_EXECUTE;
+            break;
+        case RENDER_EXECUTE:
+            // A single character or command per call
+            if(render_text.length > 0)
+                render_character();
+            else if(!render_command()) {
+                layer_canvas_commit();
+                render_canvas = NULL;
+                render_state = RENDER_IDLE;
+            }
+            break;
+    }
+}
\ No newline at end of file
@@ -16,7 +16,10 @@
 
 #define SPI_SPICON_RESET_WORD       0x0
 
+#define SPI_SPICON_SRXISEL_MASK     MASK(0x3, 0)
+
 #define SPI_SPISTAT_SPITBF_MASK     BIT(1)
+#define SPI_SPISTAT_SPIROV_MASK     BIT(6)
 
 struct spi_register_map
 {
@@ -71,6 +74,7 @@ struct spi_module
     
     unsigned char fifo_depth;
     unsigned char fifo_size;
+    unsigned char receive_size; // Bytes available on each receive interrupt
     bool assigned;
 };
 
@@ -81,6 +85,7 @@ struct spi_module spi_modules[] =
         .spi_int = &spi_module_interrupts[SPI_CHANNEL1],
         .fifo_depth = SPI_FIFO_DEPTH_MODE8,
         .fifo_size = SPI_FIFO_SIZE_MODE8,
+        .receive_size = SPI_FIFO_SIZE_MODE8,
         .assigned = false,
     }, 
     [SPI_CHANNEL2] = {
@@ -88,6 +93,7 @@ struct spi_module spi_modules[] =
         .spi_int = &spi_module_interrupts[SPI_CHANNEL2],
         .fifo_depth = SPI_FIFO_DEPTH_MODE8,
         .fifo_size = SPI_FIFO_SIZE_MODE8,
+        .receive_size = SPI_FIFO_SIZE_MODE8,
         .assigned = false,
     }
 };
@@ -145,6 +151,21 @@ void spi_configure(struct spi_module* module, struct spi_config config)
         module->fifo_depth = SPI_FIFO_DEPTH_MODE16;
         module->fifo_size = SPI_FIFO_SIZE_MODE16;
     }
+    
+    // Without the enhanced buffer there is only room for a single element
+    module->receive_size = module->fifo_size;
+    if(config.spicon_flags & SPI_ENHBUF) {
+        switch(config.spicon_flags & SPI_SPICON_SRXISEL_MASK) {
+            case SPI_SRXISEL_FULL:
+                module->receive_size = module->fifo_depth * module->fifo_size;
+                break;
+            case SPI_SRXISEL_FULL_ONE_HALF:
+                module->receive_size = (module->fifo_depth >> 1) * module->fifo_size;
+                break;
+            default:
+                break;
+        }
+    }
 }
 
 void spi_configure_dma_src(struct spi_module* module, struct dma_channel* channel)
@@ -163,8 +184,8 @@ void spi_configure_dma_src(struct spi_module* module, struct dma_channel* channe
         .irq_vector = module->spi_int->fault_irq,
     };
     
-    dma_configure_src(channel, &module->spi_reg->spibuf, 1); // one fifo_size per transfer
-    dma_configure_cell(channel, module->fifo_size);
+    dma_configure_src(channel, &module->spi_reg->spibuf, module->fifo_size); // Read whole elements from the buffer
+    dma_configure_cell(channel, module->receive_size); // Empty what triggered the receive interrupt
     dma_configure_start_event(channel, start_event);
     dma_configure_abort_event(channel, abort_event);
 }
@@ -185,7 +206,7 @@ void spi_configure_dma_dst(struct spi_module* module, struct dma_channel* channe
         .irq_vector = module->spi_int->fault_irq,
     };
     
-    dma_configure_dst(channel, &module->spi_reg->spibuf, 1); // one fifo_size per transfer
+    dma_configure_dst(channel, &module->spi_reg->spibuf, module->fifo_size); // Write whole elements to the buffer
     dma_configure_cell(channel, module->fifo_size);
     dma_configure_start_event(channel, start_event);
     dma_configure_abort_event(channel, abort_event);
@@ -239,4 +260,15 @@ bool spi_transmit_mode8(struct spi_module* module, unsigned char* buffer, unsign
     return result;
 }
 
-
+bool spi_receive_overflow(struct spi_module* module)
+{
+    ASSERT(NULL != module);
+    const struct spi_register_map* const spi_reg = module->spi_reg;
+    
+    // Received data was lost since the last call
+    if(atomic_reg_value(spi_reg->spistat) & SPI_SPISTAT_SPIROV_MASK) {
+        atomic_reg_clr(spi_reg->spistat, SPI_SPISTAT_SPIROV_MASK);
+        return true;
+    }
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "../include/stack.h"
+#include "../include/stack_config.h"
+#include "../include/stack_worst_case.h"
+#include "../include/assert.h"
+
+#if !defined(STACK_SIZE)
+    #error "Stack size not specified, please define 'STACK_SIZE'"
+#elif !defined(STACK_PAINT_PATTERN) || !defined(STACK_PAINT_MARGIN)
+    #error "Stack paint pattern or margin not specified, please define 'STACK_PAINT_PATTERN' and 'STACK_PAINT_MARGIN'"
+#elif (STACK_WORST_CASE > STACK_SIZE)
+    #error "Worst case stack usage exceeds the stack size, please increase 'STACK_SIZE' and the stack size of the linker script"
+#endif
+
+#define STACK_WORD_SIZE             sizeof(unsigned int)
+
+// Provided by the linker, the stack grows down from _stack to _splim
+extern unsigned int _stack;
+extern unsigned int _splim;
+
+static unsigned int* stack_current_pointer(void);
+
+static volatile unsigned int stack_nesting = 0;
+static unsigned int stack_nesting_max = 0;
+static unsigned char stack_isr_nesting[__STACK_ISR_COUNT];
+
+void stack_paint(void)
+{
+    // Interrupts must be disabled, everything below the stack pointer is free to overwrite
+    unsigned int* end = stack_current_pointer() - (STACK_PAINT_MARGIN / STACK_WORD_SIZE);
+    unsigned int* ptr;
+    
+    for(ptr = &_splim; ptr < end; ++ptr)
+        *ptr = STACK_PAINT_PATTERN;
+}
+
+unsigned int stack_high_water_mark(void)
+{
+    unsigned int* ptr = &_splim;
+    
+    while(ptr < &_stack && *ptr == STACK_PAINT_PATTERN)
+        ptr++;
+    return (unsigned int)(&_stack - ptr) * STACK_WORD_SIZE;
+}
+
+void stack_isr_enter(int isr)
+{
+    INT_ASSERT(isr >= 0 && isr < __STACK_ISR_COUNT);
+    
+    // An ISR that nests on top of us leaves the counter as it found it
+    unsigned int nesting = ++stack_nesting;
+    
+    if(nesting > stack_nesting_max)
+        stack_nesting_max = nesting;
+    if(nesting > stack_isr_nesting[isr])
+        stack_isr_nesting[isr] = nesting;
+}
+
+void stack_isr_exit(void)
+{
+    stack_nesting--;
+}
+
+struct stack_statistics stack_statistics(void)
+{
+    struct stack_statistics statistics = 
+    {
+        .size = STACK_SIZE,
+        .used = stack_high_water_mark(),
+        .worst_case = STACK_WORST_CASE,
+        .nesting = stack_nesting_max,
+    };
+    
+    for(int i = 0; i < __STACK_ISR_COUNT; ++i)
+        statistics.isr_nesting[i] = stack_isr_nesting[i];
+    return statistics;
+}
+
+static unsigned int* stack_current_pointer(void)
+{
+    unsigned int* sp;
+    __asm volatile("move %0, $sp" : "=r"(sp));
+    return sp;
+}
\ No newline at end of file
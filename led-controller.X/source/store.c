@@ -0,0 +1,362 @@
+#include "../include/store.h"
+#include "../include/store_config.h"
+#include "../include/firmware.h"
+#include "../include/firmware_config.h"
+#include "../include/nvm.h"
+#include "../include/sys.h"
+#include "../include/kernel_task.h"
+#include "../include/assert.h"
+#include <stddef.h>
+#include <string.h>
+
+#if !defined(STORE_PAGE_BEGIN) || (STORE_PAGE_BEGIN % NVM_PAGE_SIZE)
+    #error "Store pages not specified or not page aligned, please define 'STORE_PAGE_BEGIN'"
+#elif !defined(STORE_PAGES) || (STORE_PAGES < 2)
+    #error "Store needs at least 2 pages, please define 'STORE_PAGES'"
+#elif (FIRMWARE_UPDATE == 1) && (STORE_PAGE_BEGIN < FIRMWARE_SLOT_A + FIRMWARE_SLOT_SIZE) && (STORE_PAGE_BEGIN + STORE_PAGES * NVM_PAGE_SIZE > FIRMWARE_SLOT_A)
+    #error "Store pages overlap firmware slot A"
+#elif (FIRMWARE_UPDATE == 1) && (STORE_PAGE_BEGIN < FIRMWARE_SLOT_B + FIRMWARE_SLOT_SIZE) && (STORE_PAGE_BEGIN + STORE_PAGES * NVM_PAGE_SIZE > FIRMWARE_SLOT_B)
+    #error "Store pages overlap firmware slot B"
+#elif !defined(STORE_COALESCE_TIME)
+    #error "Store coalesce time not specified, please define 'STORE_COALESCE_TIME'"
+#elif !defined(STORE_RETRIES) || (STORE_RETRIES < 1)
+    #error "Store retries must be at least 1, please define 'STORE_RETRIES'"
+#endif
+
+#define STORE_WORD_SIZE             sizeof(unsigned int)
+#define STORE_MAGIC                 0x53544f52 // "STOR"
+#define STORE_ERASED                0xffffffff
+#define STORE_PAGE_NONE             STORE_PAGES
+#define STORE_HEADER_SIZE           (2 * STORE_WORD_SIZE) // Sequence and magic
+#define STORE_CRC_POLYNOMIAL        0x1021
+#define STORE_CRC_SEED              0xffff
+#define STORE_COALESCE_TICKS        SYS_CORE_TIMER_TICKS(STORE_COALESCE_TIME * 1000000LLU)
+
+#define store_page_address(page)    (STORE_PAGE_BEGIN + (page) * NVM_PAGE_SIZE)
+#define store_flash_word(address)   (*(const volatile unsigned int*)NVM_KSEG1_ADDR(address))
+#define store_record_words(size)    (1 + store_value_words(size)) // Header and padded value
+#define store_value_words(size)     (((size) + STORE_WORD_SIZE - 1) / STORE_WORD_SIZE)
+#define store_record_header(key, words, crc) \
+            ((key) | ((unsigned int)(words) << 8) | ((unsigned int)(crc) << 16))
+
+enum store_state
+{
+    STORE_IDLE = 0,
+    STORE_WRITE_RECORD,
+    STORE_COMPACT_ERASE,
+    STORE_COMPACT_RECORD,
+    STORE_COMPACT_HEADER,
+};
+
+static void store_load(void);
+static void store_load_page(unsigned int page);
+static unsigned short store_crc16(unsigned int key, const volatile unsigned char* value, unsigned int size);
+static unsigned int store_record_word(unsigned int index);
+static bool store_record_next(bool compact);
+static void store_compact(unsigned int page);
+static void store_write_failed(void);
+
+static int store_rtask_init(void);
+static void store_rtask_execute(void);
+KERN_RTASK(store, store_rtask_init, store_rtask_execute, NULL, KERN_INIT_EARLY);
+
+static const unsigned short store_sizes[__STORE_KEY_COUNT] =
+{
+    [STORE_KEY_BOARD_ADDRESS] = STORE_SIZE_BOARD_ADDRESS,
+    [STORE_KEY_DOT_CORRECTION] = STORE_SIZE_DOT_CORRECTION,
+    [STORE_KEY_GAMMA] = STORE_SIZE_GAMMA,
+    [STORE_KEY_REFRESH_INTERVAL] = STORE_SIZE_REFRESH_INTERVAL,
+    [STORE_KEY_CLOCK_PROFILE] = STORE_SIZE_CLOCK_PROFILE,
+    [STORE_KEY_DEAD_TIME] = STORE_SIZE_DEAD_TIME,
+    [STORE_KEY_REMAP] = STORE_SIZE_REMAP,
+    [STORE_KEY_PERMUTATION] = STORE_SIZE_PERMUTATION,
+};
+
+static unsigned char store_values[STORE_SIZE_BOARD_ADDRESS + STORE_SIZE_DOT_CORRECTION + STORE_SIZE_GAMMA
+    + STORE_SIZE_REFRESH_INTERVAL + STORE_SIZE_CLOCK_PROFILE + STORE_SIZE_DEAD_TIME + STORE_SIZE_REMAP + STORE_SIZE_PERMUTATION] __attribute__((aligned(4)));
+static unsigned short store_offsets[__STORE_KEY_COUNT]; // Offset of each value in the RAM copy
+static bool store_present[__STORE_KEY_COUNT];
+static bool store_dirty[__STORE_KEY_COUNT];
+static enum store_state store_state = STORE_IDLE;
+static unsigned int store_page = STORE_PAGE_NONE; // Active page
+static unsigned int store_sequence = 0; // Sequence number of the active page
+static unsigned int store_address = 0; // Next free address of the active page
+static unsigned int store_changed = 0; // Core timer value of the last change
+static bool store_flush_requested = false;
+static int store_key = 0; // Key of the record that is written
+static unsigned int store_index = 0; // Next word of the record that is written
+static unsigned short store_crc = 0; // CRC of the record that is written
+static bool store_writing = false; // Whether the last flash operation was started by the store
+static unsigned int store_failures = 0; // Number of consecutive failed flash operations
+static bool store_failed = false; // Gave up writing until reset
+
+bool store_get(int key, void* value, unsigned int size)
+{
+    ASSERT(NULL != value);
+    
+    if(key < 0 || key >= __STORE_KEY_COUNT)
+        return false;
+    if(size != store_sizes[key] || !store_present[key])
+        return false;
+    
+    memcpy(value, &store_values[store_offsets[key]], size);
+    return true;
+}
+
+bool store_set(int key, const void* value, unsigned int size)
+{
+    ASSERT(NULL != value);
+    
+    if(key < 0 || key >= __STORE_KEY_COUNT)
+        return false;
+    if(size != store_sizes[key])
+        return false;
+    
+    // Only the RAM copy is changed, the record is written once the changes settled
+    memcpy(&store_values[store_offsets[key]], value, size);
+    store_present[key] = true;
+    store_dirty[key] = true;
+    store_changed = sys_core_timer();
+    return true;
+}
+
+void store_flush(void)
+{
+    store_flush_requested = true;
+}
+
+bool store_busy(void)
+{
+    if(store_failed)
+        return false;
+    if(STORE_IDLE != store_state)
+        return true;
+    for(int i = 0; i < __STORE_KEY_COUNT; ++i) {
+        if(store_dirty[i])
+            return true;
+    }
+    return false;
+}
+
+bool store_error(void)
+{
+    return store_failed;
+}
+
+static void store_load(void)
+{
+    unsigned int sequence;
+    
+    // The active page has a complete header with the newest sequence number
+    for(unsigned int i = 0; i < STORE_PAGES; ++i) {
+        if(STORE_MAGIC != store_flash_word(store_page_address(i) + STORE_WORD_SIZE))
+            continue;
+        sequence = store_flash_word(store_page_address(i));
+        if(STORE_PAGE_NONE == store_page || (int)(sequence - store_sequence) > 0) {
+            store_page = i;
+            store_sequence = sequence;
+        }
+    }
+    
+    if(STORE_PAGE_NONE != store_page)
+        store_load_page(store_page);
+}
+
+static void store_load_page(unsigned int page)
+{
+    unsigned int address = store_page_address(page) + STORE_HEADER_SIZE;
+    unsigned int end = store_page_address(page) + NVM_PAGE_SIZE;
+    const volatile unsigned char* value;
+    unsigned int header;
+    unsigned int key;
+    unsigned int words;
+    
+    while(address < end) {
+        header = store_flash_word(address);
+        if(STORE_ERASED == header)
+            break;
+        
+        key = header & 0xff;
+        words = (header >> 8) & 0xff;
+        if(address + (1 + words) * STORE_WORD_SIZE > end)
+            break;
+        
+        // Skip records of unknown keys and records that weren't written completely
+        value = (const volatile unsigned char*)NVM_KSEG1_ADDR(address + STORE_WORD_SIZE);
+        if(key < __STORE_KEY_COUNT && words == store_value_words(store_sizes[key])
+                && (header >> 16) == store_crc16(key, value, store_sizes[key])) {
+            for(unsigned int i = 0; i < store_sizes[key]; ++i)
+                store_values[store_offsets[key] + i] = value[i];
+            store_present[key] = true;
+        }
+        address += (1 + words) * STORE_WORD_SIZE;
+    }
+    store_address = address;
+}
+
+static unsigned short store_crc16(unsigned int key, const volatile unsigned char* value, unsigned int size)
+{
+    unsigned short crc = STORE_CRC_SEED;
+    unsigned int data;
+    
+    // Over the key and the value
+    for(unsigned int i = 0; i <= size; ++i) {
+        data = 0 == i ? key : value[i - 1];
+        crc ^= data << 8;
+        for(unsigned int j = 0; j < 8; ++j)
+            crc = (crc & 0x8000) ? (crc << 1) ^ STORE_CRC_POLYNOMIAL : crc << 1;
+    }
+    return crc;
+}
+
+static unsigned int store_record_word(unsigned int index)
+{
+    unsigned int size = store_sizes[store_key];
+    unsigned int offset = (index - 1) * STORE_WORD_SIZE;
+    unsigned int word = STORE_ERASED;
+    
+    if(0 == index)
+        return store_record_header(store_key, store_value_words(size), store_crc);
+    
+    // Value padded with erased bytes
+    memcpy(&word, &store_values[store_offsets[store_key] + offset], size - offset < STORE_WORD_SIZE ? size - offset : STORE_WORD_SIZE);
+    return word;
+}
+
+static bool store_record_next(bool compact)
+{
+    // Compacting writes all present values, otherwise only the changed values
+    for(; store_key < __STORE_KEY_COUNT; ++store_key) {
+        if(compact ? store_present[store_key] : store_dirty[store_key]) {
+            store_dirty[store_key] = false;
+            store_crc = store_crc16(store_key, &store_values[store_offsets[store_key]], store_sizes[store_key]);
+            store_index = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void store_compact(unsigned int page)
+{
+    // All present values are written to the page, its header last
+    store_page = page;
+    store_writing = nvm_erase_page(store_page_address(store_page));
+    store_state = STORE_COMPACT_ERASE;
+}
+
+static void store_write_failed(void)
+{
+    if(++store_failures >= STORE_RETRIES) {
+        store_failed = true;
+        store_state = STORE_IDLE;
+        return;
+    }
+    
+    // The failed record can't be programmed again, so it is written to the next page along with all other values.
+    // A failed compaction starts over in the same page, the previous page stays valid until the header is complete
+    if(STORE_WRITE_RECORD == store_state) {
+        store_dirty[store_key] = true;
+        store_sequence++;
+        store_compact((store_page + 1) % STORE_PAGES);
+    } else
+        store_compact(store_page);
+}
+
+static int store_rtask_init(void)
+{
+    unsigned int offset = 0;
+    
+    for(int i = 0; i < __STORE_KEY_COUNT; ++i) {
+        ASSERT(store_value_words(store_sizes[i]) <= 0xff);
+        store_offsets[i] = offset;
+        offset += store_sizes[i];
+    }
+    ASSERT(offset == sizeof(store_values));
+    
+    store_load();
+    return KERN_INIT_SUCCCES;
+}
+
+static void store_rtask_execute(void)
+{
+    bool settled;
+    
+    // Check the outcome of each flash operation before starting the next one
+    if(STORE_IDLE != store_state) {
+        if(nvm_busy())
+            return;
+        if(store_writing && nvm_error()) {
+            store_writing = false;
+            store_write_failed();
+            return;
+        }
+        store_writing = false;
+    }
+    
+    switch(store_state) {
+        default:
+        case STORE_IDLE:
+            settled = store_flush_requested || sys_core_timer() - store_changed >= STORE_COALESCE_TICKS;
+            if(!settled || store_failed || nvm_busy())
+                break;
+#if (FIRMWARE_UPDATE == 1)
+            if(FIRMWARE_STATUS_BUSY == firmware_update_status())
+                break;
+#endif
+            
+            store_key = 0;
+            if(!store_record_next(false)) {
+                store_flush_requested = false;
+                break;
+            }
+            
+            // Start over in the next page of the ring if the record doesn't fit
+            if(STORE_PAGE_NONE == store_page
+                    || store_address + store_record_words(store_sizes[store_key]) * STORE_WORD_SIZE > store_page_address(store_page) + NVM_PAGE_SIZE) {
+                store_dirty[store_key] = true;
+                store_sequence++;
+                store_compact(STORE_PAGE_NONE == store_page ? 0 : (store_page + 1) % STORE_PAGES);
+            } else
+                store_state = STORE_WRITE_RECORD;
+            break;
+        case STORE_WRITE_RECORD:
+        case STORE_COMPACT_RECORD:
+            if(store_index < store_record_words(store_sizes[store_key])) {
+                store_writing = nvm_write_word(store_address, store_record_word(store_index++));
+                store_address += STORE_WORD_SIZE;
+                break;
+            }
+            
+            // Record is written, continue with the next record when compacting
+            if(STORE_WRITE_RECORD == store_state) {
+                store_failures = 0;
+                store_state = STORE_IDLE;
+            } else {
+                store_key++;
+                if(!store_record_next(true)) {
+                    store_index = 0;
+                    store_state = STORE_COMPACT_HEADER;
+                }
+            }
+            break;
+        case STORE_COMPACT_ERASE:
+            store_address = store_page_address(store_page) + STORE_HEADER_SIZE;
+            store_key = 0;
+            store_state = store_record_next(true) ? STORE_COMPACT_RECORD : STORE_COMPACT_HEADER;
+            store_index = 0;
+            break;
+        case STORE_COMPACT_HEADER:
+            // Sequence first and the magic last, the page only becomes valid once complete
+            if(0 == store_index)
+                store_writing = nvm_write_word(store_page_address(store_page), store_sequence);
+            else if(1 == store_index)
+                store_writing = nvm_write_word(store_page_address(store_page) + STORE_WORD_SIZE, STORE_MAGIC);
+            else {
+                store_failures = 0;
+                store_state = STORE_IDLE;
+            }
+            store_index++;
+            break;
+    }
+}
\ No newline at end of file
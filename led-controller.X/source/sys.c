@@ -10,6 +10,7 @@
 #define SYS_OSCCON_CF_MASK              BIT(3)
 #define SYS_INTCON_MVEC_MASK            BIT(12)
 #define SYS_CFGCON_IOLOCK               BIT(12)
+#define SYS_STATUS_IE_MASK              BIT(0)
 
 void sys_lock(void)
 {
@@ -35,6 +36,22 @@ void sys_disable_global_interrupt()
     __asm("di");
 }
 
+unsigned int sys_suspend_global_interrupt(void)
+{
+    unsigned int status;
+    
+    // The memory clobber keeps accesses inside the critical section, the hazard barrier lets di take effect first
+    __asm volatile("di %0; ehb" : "=r"(status) : : "memory");
+    return status;
+}
+
+void sys_resume_global_interrupt(unsigned int status)
+{
+    // Only enable if they were enabled before suspending
+    if(status & SYS_STATUS_IE_MASK)
+        __asm volatile("ei" : : : "memory");
+}
+
 void sys_cpu_early_init(void)
 {   
     // Wait for valid clock
@@ -47,4 +64,10 @@ void sys_cpu_early_init(void)
     
     // Configure other stuff
     REG_SET(SYS_INTCON_REG, SYS_INTCON_MVEC_MASK);
+}
+
+void sys_core_timer_wait(unsigned int begin, unsigned int ticks)
+{
+    // Unsigned arithmetic handles the core timer wrapping around
+    while((unsigned int)(sys_core_timer() - begin) < ticks);
 }
\ No newline at end of file
@@ -196,4 +196,5 @@ static void timer_ttask_configure(struct kernel_ttask_param* const param)
 {
     kernel_ttask_set_priority(param, KERN_TTASK_PRIORITY_HIGH);
     kernel_ttask_set_interval(param, TIMER_TICK_INTERVAL, KERN_TIME_UNIT_US);
+    kernel_ttask_set_budget(param, TIMER_TICK_BUDGET, KERN_TIME_UNIT_US);
 }
\ No newline at end of file
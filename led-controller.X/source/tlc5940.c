@@ -6,6 +6,7 @@
 #include "../include/sys.h"
 #include "../include/toolbox.h"
 #include "../include/kernel_task.h"
+#include "../include/store.h"
 #include <stddef.h>
 #include <string.h>
 
@@ -17,6 +18,9 @@
 #define TLC5940_BUFFER_SIZE             (24 * TLC5940_NUM_OF_DEVICES)
 #define TLC5940_BUFFER_SIZE_DOT_CORR    (12 * TLC5940_NUM_OF_DEVICES)
 #define TLC5940_CHANNEL_SIZE            (TLC5940_CHANNELS_PER_DEVICE * TLC5940_NUM_OF_DEVICES)
+#define TLC5940_GSCLK_PER_CYCLE         4096 // GSCLK periods per grayscale cycle
+#define TLC5940_GSCLK_MAX_FREQUENCY     10000000
+#define TLC5940_GSCLK_MIN_FREQUENCY     1000000 // Lowest clock profile, a grayscale cycle of 4.1 ms
 
 #define TLC5940_SPI_CHANNEL             SPI_CHANNEL2
 #define TLC5940_SDO_PPS                 RPG7R
@@ -54,6 +58,7 @@ enum tlc5940_state
 {
     TLC5940_INIT = 0,
     TLC5940_WRITE_DOT_CORRECTION,
+    TLC5940_WRITE_DOT_CORRECTION_WAIT,
     TLC5940_IDLE,
     TLC5940_UPDATE,
     TLC5940_UPDATE_DMA_START,
@@ -64,7 +69,9 @@ enum tlc5940_state
 };
 
 static void tlc5940_pwm_period_callback(void);
+static void tlc5940_clear_buffer_complete(void);
 static int tlc5940_rtask_init(void);
+static unsigned int tlc5940_gsclk_compute(void);
 static void tlc5940_rtask_execute(void);
 KERN_QUICK_RTASK(tlc5940, tlc5940_rtask_init, tlc5940_rtask_execute);
 
@@ -73,6 +80,7 @@ static unsigned char tlc5940_back_buffer[TLC5940_BUFFER_SIZE];
 static unsigned char tlc5940_dot_corr_buffer[TLC5940_BUFFER_SIZE_DOT_CORR];
 static unsigned char* tlc5940_dma_ptr = tlc5940_back_buffer;
 static unsigned char* tlc5940_draw_ptr = tlc5940_front_buffer;
+static const unsigned char* tlc5940_raw_ptr = NULL; // Bitstream of the current update, if not packed by us
 
 static const struct dma_config tlc5940_dma_config; // No special config needed
 static const struct spi_config tlc5940_spi_config =
@@ -84,15 +92,27 @@ static const struct spi_config tlc5940_spi_config =
 static const struct pwm_config tlc5940_pwm_config =
 {
     .duty = 0.5,
-    .frequency = 10000000,
+    .frequency = TLC5940_GSCLK_MAX_FREQUENCY,
     .period_callback = &tlc5940_pwm_period_callback,
-    .period_callback_div = 4096 // Every 4096 PWM periods (one GSCLK period), call the callback
+    .period_callback_div = TLC5940_GSCLK_PER_CYCLE // Every 4096 PWM periods (one GSCLK period), call the callback
 };
 
 static void (*tlc5940_latch_callback)(void) = NULL;
 static struct dma_channel* tlc5940_dma_channel = NULL;
 static struct spi_module* tlc5940_spi_module = NULL;
 static enum tlc5940_state tlc5940_state = TLC5940_INIT;
+static unsigned int tlc5940_gsclk_frequency = 0; // Pending GSCLK frequency, applied during the next latch
+static unsigned int tlc5940_gsclk_limit = TLC5940_GSCLK_MAX_FREQUENCY; // GSCLK frequency ceiling of the clock profile
+static unsigned int tlc5940_cycle_time = 0; // Requested grayscale cycle time in us, 0 for the fastest cycle
+static volatile bool tlc5940_buffer_cleared = false;
+
+void tlc5940_early_init(void)
+{
+    // Blank the outputs right after reset, the grayscale registers hold random data until the first latch
+    REG_SET(TLC5940_BLANK_LAT, TLC5940_BLANK_PIN_MASK);
+    REG_CLR(TLC5940_BLANK_ANSEL, TLC5940_BLANK_PIN_MASK);
+    REG_CLR(TLC5940_BLANK_TRIS, TLC5940_BLANK_PIN_MASK);
+}
 
 bool tlc5940_busy(void)
 {
@@ -112,6 +132,20 @@ bool tlc5940_update(void)
     unsigned char *dma_ptr = tlc5940_dma_ptr;
     tlc5940_dma_ptr = tlc5940_draw_ptr;
     tlc5940_draw_ptr = dma_ptr;
+    tlc5940_raw_ptr = NULL;
+    tlc5940_state = TLC5940_UPDATE;
+    return true;
+}
+
+bool tlc5940_update_raw(const unsigned char* buffer, unsigned int size)
+{
+    if(tlc5940_busy())
+        return false;
+    if(TLC5940_BUFFER_SIZE != size)
+        return false;
+    
+    // Stream the bitstream as is, the buffer must stay untouched until ready again
+    tlc5940_raw_ptr = buffer;
     tlc5940_state = TLC5940_UPDATE;
     return true;
 }
@@ -145,6 +179,54 @@ void tlc5940_write_grayscale(unsigned int device, unsigned int channel, unsigned
     tlc5940_draw_ptr[index + 1] |= byte2;
 }
 
+void tlc5940_set_cycle_time(unsigned int time)
+{
+    if(0 == time)
+        return;
+    
+    tlc5940_cycle_time = time;
+    tlc5940_gsclk_frequency = tlc5940_gsclk_compute();
+}
+
+bool tlc5940_set_clock_limit(unsigned int frequency)
+{
+    if(frequency < TLC5940_GSCLK_MIN_FREQUENCY || frequency > TLC5940_GSCLK_MAX_FREQUENCY)
+        return false;
+    
+    // Applied during the next latch and kept across resets
+    tlc5940_gsclk_limit = frequency;
+    tlc5940_gsclk_frequency = tlc5940_gsclk_compute();
+    store_set(STORE_KEY_CLOCK_PROFILE, &tlc5940_gsclk_limit, sizeof(tlc5940_gsclk_limit));
+    return true;
+}
+
+bool tlc5940_set_dot_correction(const unsigned char* buffer, unsigned int size)
+{
+    if(tlc5940_busy() || size != TLC5940_BUFFER_SIZE_DOT_CORR)
+        return false;
+    
+    // Shifted in between two grayscale updates and kept across resets
+    memcpy(tlc5940_dot_corr_buffer, buffer, TLC5940_BUFFER_SIZE_DOT_CORR);
+    store_set(STORE_KEY_DOT_CORRECTION, tlc5940_dot_corr_buffer, TLC5940_BUFFER_SIZE_DOT_CORR);
+    tlc5940_state = TLC5940_WRITE_DOT_CORRECTION;
+    return true;
+}
+
+static void tlc5940_clear_buffer_complete(void)
+{
+    tlc5940_buffer_cleared = true;
+}
+
+static unsigned int tlc5940_gsclk_compute(void)
+{
+    unsigned int frequency = tlc5940_gsclk_limit;
+    
+    // Round the frequency up, so a full grayscale cycle always fits in the requested time if the ceiling allows
+    if(0 != tlc5940_cycle_time)
+        frequency = (TLC5940_GSCLK_PER_CYCLE * 1000000LLU + tlc5940_cycle_time - 1) / tlc5940_cycle_time;
+    return frequency > tlc5940_gsclk_limit ? tlc5940_gsclk_limit : frequency;
+}
+
 static void tlc5940_pwm_period_callback(void)
 {
     REG_SET(TLC5940_BLANK_LAT, TLC5940_BLANK_PIN_MASK);
@@ -153,8 +235,15 @@ static void tlc5940_pwm_period_callback(void)
 
 static int tlc5940_rtask_init(void)
 {
-    // Init variables
-    memset(tlc5940_dot_corr_buffer, 0xff, TLC5940_BUFFER_SIZE_DOT_CORR);
+    struct pwm_config pwm_config = tlc5940_pwm_config;
+    unsigned int limit;
+    
+    // Init variables, use the stored dot correction and clock profile if there are
+    if(!store_get(STORE_KEY_DOT_CORRECTION, tlc5940_dot_corr_buffer, TLC5940_BUFFER_SIZE_DOT_CORR))
+        memset(tlc5940_dot_corr_buffer, 0xff, TLC5940_BUFFER_SIZE_DOT_CORR);
+    if(store_get(STORE_KEY_CLOCK_PROFILE, &limit, sizeof(limit))
+        && limit >= TLC5940_GSCLK_MIN_FREQUENCY && limit <= TLC5940_GSCLK_MAX_FREQUENCY)
+        tlc5940_gsclk_limit = limit;
     
     // Configure PPS
     sys_unlock();
@@ -176,8 +265,8 @@ static int tlc5940_rtask_init(void)
     REG_CLR(TLC5940_VPRG_TRIS, TLC5940_VPRG_PIN_MASK);
     REG_CLR(TLC5940_DCPRG_TRIS, TLC5940_DCPRG_PIN_MASK);
     
-    // Define output states
-    REG_CLR(TLC5940_BLANK_LAT, TLC5940_BLANK_PIN_MASK);
+    // Define output states, BLANK stays high until the first latch
+    REG_SET(TLC5940_BLANK_LAT, TLC5940_BLANK_PIN_MASK);
     REG_CLR(TLC5940_XLAT_LAT, TLC5940_XLAT_PIN_MASK);
     REG_CLR(TLC5940_VPRG_LAT, TLC5940_VPRG_PIN_MASK);
     REG_SET(TLC5940_DCPRG_LAT, TLC5940_DCPRG_PIN_MASK);
@@ -194,9 +283,9 @@ static int tlc5940_rtask_init(void)
     spi_configure_dma_dst(tlc5940_spi_module, tlc5940_dma_channel); // SPI module is the destination of the dma module
     spi_enable(tlc5940_spi_module);
     
-    // Initialize PWM
-    pwm_configure(tlc5940_pwm_config);
-    pwm_enable();
+    // Initialize PWM at the ceiling of the clock profile, it is enabled at the first latch
+    pwm_config.frequency = tlc5940_gsclk_limit;
+    pwm_configure(pwm_config);
     
     return KERN_INIT_SUCCCES;
     
@@ -214,19 +303,27 @@ static void tlc5940_rtask_execute(void)
         case TLC5940_INIT:
             // no break
         case TLC5940_WRITE_DOT_CORRECTION:
-            REG_SET(TLC5940_VPRG_LAT, TLC5940_VPRG_PIN_MASK);
-            spi_transmit_mode8(tlc5940_spi_module, tlc5940_dot_corr_buffer, TLC5940_BUFFER_SIZE_DOT_CORR);
-            REG_SET(TLC5940_XLAT_LAT, TLC5940_XLAT_PIN_MASK);
-            REG_CLR(TLC5940_XLAT_LAT, TLC5940_XLAT_PIN_MASK);
-            REG_CLR(TLC5940_VPRG_LAT, TLC5940_VPRG_PIN_MASK);
-            tlc5940_state = TLC5940_IDLE;
+            if(dma_ready(tlc5940_dma_channel)) {
+                REG_SET(TLC5940_VPRG_LAT, TLC5940_VPRG_PIN_MASK);
+                dma_configure_src(tlc5940_dma_channel, tlc5940_dot_corr_buffer, TLC5940_BUFFER_SIZE_DOT_CORR);
+                dma_enable_transfer(tlc5940_dma_channel);
+                tlc5940_state = TLC5940_WRITE_DOT_CORRECTION_WAIT;
+            }
+            break;
+        case TLC5940_WRITE_DOT_CORRECTION_WAIT:
+            if(dma_ready(tlc5940_dma_channel)) {
+                REG_SET(TLC5940_XLAT_LAT, TLC5940_XLAT_PIN_MASK);
+                REG_CLR(TLC5940_XLAT_LAT, TLC5940_XLAT_PIN_MASK);
+                REG_CLR(TLC5940_VPRG_LAT, TLC5940_VPRG_PIN_MASK);
+                tlc5940_state = TLC5940_IDLE;
+            }
             break;
         case TLC5940_IDLE:
             break;
         case TLC5940_UPDATE:
         case TLC5940_UPDATE_DMA_START:
             if(dma_ready(tlc5940_dma_channel)) {
-                dma_configure_src(tlc5940_dma_channel, tlc5940_dma_ptr, TLC5940_BUFFER_SIZE);
+                dma_configure_src(tlc5940_dma_channel, NULL != tlc5940_raw_ptr ? tlc5940_raw_ptr : tlc5940_dma_ptr, TLC5940_BUFFER_SIZE);
                 dma_enable_transfer(tlc5940_dma_channel);
                 tlc5940_state = TLC5940_UPDATE_DMA_WAIT;
             }
@@ -252,16 +349,34 @@ static void tlc5940_rtask_execute(void)
             
             if(NULL != tlc5940_latch_callback)
                 tlc5940_latch_callback();
+            
+            // Apply the new grayscale cycle time while PWM is disabled anyway
+            if(0 != tlc5940_gsclk_frequency) {
+                struct pwm_config config = tlc5940_pwm_config;
+                config.frequency = tlc5940_gsclk_frequency;
+                pwm_configure(config);
+                tlc5940_gsclk_frequency = 0;
+            }
 
             // Enable PWM
             REG_CLR(TLC5940_BLANK_LAT, TLC5940_BLANK_PIN_MASK);
             pwm_enable();
             
-            tlc5940_state = TLC5940_UPDATE_CLEAR_BUFFER;
+            // A raw bitstream didn't touch our buffers, so there is nothing to clear
+            tlc5940_state = NULL != tlc5940_raw_ptr ? TLC5940_IDLE : TLC5940_UPDATE_CLEAR_BUFFER;
             break;
         case TLC5940_UPDATE_CLEAR_BUFFER:
-            memset(tlc5940_dma_ptr, 0x00, TLC5940_BUFFER_SIZE);
-            tlc5940_state = TLC5940_IDLE;
+            tlc5940_buffer_cleared = false;
+            if(dma_mem_fill(tlc5940_dma_ptr, 0x00, TLC5940_BUFFER_SIZE, tlc5940_clear_buffer_complete))
+                tlc5940_state = TLC5940_UPDATE_CLEAR_BUFFER_WAIT;
+            else { // Memory service is fully booked, clear it ourselves
+                memset(tlc5940_dma_ptr, 0x00, TLC5940_BUFFER_SIZE);
+                tlc5940_state = TLC5940_IDLE;
+            }
+            break;
+        case TLC5940_UPDATE_CLEAR_BUFFER_WAIT:
+            if(tlc5940_buffer_cleared)
+                tlc5940_state = TLC5940_IDLE;
             break;
     }
 }
\ No newline at end of file
@@ -24,7 +24,7 @@
 
 #define UART_UMODE_WORD         0x0
 #define UART_USTA_WORD          BIT(10) | BIT(12) | MASK(0x1, 14)
-#define UART_BRG_WORD           ((SYS_PB_CLOCK / UART_BAUDRATE) >> 4 - 1)
+#define UART_BRG_WORD           (((SYS_PB_CLOCK / UART_BAUDRATE) >> 4) - 1)
 
 #define UART_ON_MASK            BIT(15)
 #define UART_ERROR_BITS_MASK    MASK(0x7, 1)
@@ -151,15 +151,15 @@ void uart_transmit_buffer(unsigned char* buffer, unsigned int size)
 
 bool uart_read_available(void)
 {
-    return uart_rx_consumer != uart_rx_consumer;
+    return uart_rx_consumer != uart_rx_producer;
 }
 
 unsigned char uart_read(void)
 {
-    ASSERT(uart_rx_consumer != uart_rx_consumer);
+    ASSERT(uart_rx_consumer != uart_rx_producer);
     
     unsigned char data = *uart_rx_consumer;
-    if(++uart_rx_consumer > uart_rx_consumer)
+    if(++uart_rx_consumer > uart_rx_end)
         uart_rx_consumer = uart_rx_begin;
     return data;
 }
@@ -167,7 +167,6 @@ unsigned char uart_read(void)
 int uart_read_buffer(unsigned char* buffer, unsigned int max_size)
 {
     ASSERT(NULL != buffer);
-    ASSERT(uart_rx_consumer != uart_rx_consumer);
     
     //@Todo: improve performance
     const unsigned char* buffer_begin = buffer;
@@ -194,10 +193,10 @@ static void uart_write(unsigned char data)
 
 static unsigned char uart_tx_take(void)
 {
-    ASSERT(uart_tx_consumer != uart_tx_consumer);
+    ASSERT(uart_tx_consumer != uart_tx_producer);
     
     unsigned char data = *uart_tx_consumer;
-    if(++uart_tx_consumer > uart_tx_consumer)
+    if(++uart_tx_consumer > uart_tx_end)
         uart_tx_consumer = uart_tx_begin;
     return data;
 }
@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+"""Derive the worst case stack usage of the firmware after a build.
+
+Runs as the post-build step of the project (see nbproject/configurations.xml). The frame of each function is taken
+from the stack usage files (*.su) that -fstack-usage writes next to the object files, the call graph from the
+disassembly of the image. The worst case is the deepest call chain from main() plus, for each interrupt priority
+level, the deepest ISR of that level, as ISRs of different levels can nest on top of each other.
+
+Indirect calls (jalr) may call any function whose address is taken, i.e. that is stored in initialized data or
+loaded into a register. Indirect calls are followed up to --indirect-depth levels deep, deeper indirect calls are
+not counted. Recursion and unbounded (dynamic) frames make the bound unknown and fail the step.
+
+The result is written to include/stack_worst_case.h, which stack.c reports through stack_statistics() from the next
+build on. The step fails once the worst case exceeds STACK_SIZE of include/stack_config.h.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+FUNCTION_RE = re.compile(r'^([0-9a-f]+) <([^>]+)>:$')
+SECTION_RE = re.compile(r'^Disassembly of section (\S+):$')
+CALL_RE = re.compile(r'\t(jal|bal|j|b)\s+[0-9a-f]+ <([^>+]+)>')
+INDIRECT_RE = re.compile(r'\t(jalr\s|jr\s+(?!ra\b))')
+LUI_RE = re.compile(r'\tlui\s+(\w+),0x([0-9a-f]+)')
+ADDIU_RE = re.compile(r'\taddiu\s+(\w+),(\w+),(-?\d+)')
+CONTENTS_RE = re.compile(r'^Contents of section (\S+):$')
+ISR_RE = re.compile(r'__ISR\s*\(\s*\w+\s*,\s*INT_IPL\s*\(\s*(\w+)\s*\)\s*\)\s*(\w+)\s*\(')
+DEFINE_RE = re.compile(r'^\s*#define\s+(\w+)\s+(0x[0-9a-fA-F]+|\d+)\b', re.MULTILINE)
+
+
+class StackError(Exception):
+    pass
+
+
+def read_frames(build_dir):
+    frames = {}
+    unbounded = set()
+    for root, _, files in os.walk(build_dir):
+        for name in files:
+            if not name.endswith('.su'):
+                continue
+            with open(os.path.join(root, name)) as su:
+                for line in su:
+                    # file:line:column:function <tab> bytes <tab> static|dynamic[,bounded]
+                    fields = line.rstrip('\n').split('\t')
+                    if len(fields) < 3:
+                        continue
+                    function = fields[0].rsplit(':', 1)[-1]
+                    frames[function] = max(frames.get(function, 0), int(fields[1]))
+                    if 'dynamic' in fields[2] and 'bounded' not in fields[2]:
+                        unbounded.add(function)
+    if not frames:
+        raise StackError('no stack usage files in %s, is -fstack-usage set?' % build_dir)
+    return frames, unbounded
+
+
+def read_call_graph(objdump, elf):
+    disassembly = subprocess.run([objdump, '-d', elf], check=True, capture_output=True, text=True).stdout
+    starts = {}
+    calls = {}
+    indirect = set()
+    taken = set()
+    vectors = set()
+    loaded = []
+    section = ''
+    function = None
+    high = {}
+    for line in disassembly.splitlines():
+        match = SECTION_RE.match(line)
+        if match:
+            section = match.group(1)
+            continue
+        match = FUNCTION_RE.match(line)
+        if match:
+            function = match.group(2)
+            starts[int(match.group(1), 16)] = function
+            calls.setdefault(function, set())
+            high = {}
+            if section.startswith('.vector_'):
+                vectors.add(function)
+            continue
+        if function is None:
+            continue
+        match = CALL_RE.search(line)
+        if match and match.group(2) != function:
+            calls[function].add(match.group(2))
+        elif INDIRECT_RE.search(line):
+            indirect.add(function)
+        # An address loaded with lui/addiu may be a function pointer
+        match = LUI_RE.search(line)
+        if match:
+            high[match.group(1)] = int(match.group(2), 16) << 16
+            continue
+        match = ADDIU_RE.search(line)
+        if match and match.group(2) in high:
+            loaded.append((high[match.group(2)] + int(match.group(3))) & 0xffffffff)
+
+    # Function pointers stored in initialized data, words are little endian
+    contents = subprocess.run([objdump, '-s', elf], check=True, capture_output=True, text=True).stdout
+    section = ''
+    for line in contents.splitlines():
+        match = CONTENTS_RE.match(line)
+        if match:
+            section = match.group(1)
+            continue
+        if section.startswith(('.debug', '.comment', '.mdebug', '.gnu', '.reginfo')):
+            continue
+        fields = line.split()
+        if len(fields) < 2 or not re.fullmatch(r'[0-9a-f]+', fields[0]):
+            continue
+        for word in fields[1:5]:
+            if re.fullmatch(r'[0-9a-f]{8}', word):
+                loaded.append(int.from_bytes(bytes.fromhex(word), 'little'))
+    taken.update(starts[address] for address in loaded if address in starts)
+    return calls, indirect, taken, vectors
+
+
+def read_isr_levels(project_dir):
+    defines = {}
+    for name in os.listdir(os.path.join(project_dir, 'include')):
+        if name.endswith('.h'):
+            with open(os.path.join(project_dir, 'include', name)) as header:
+                for macro, value in DEFINE_RE.findall(header.read()):
+                    defines[macro] = int(value, 0)
+    levels = {}
+    for name in os.listdir(os.path.join(project_dir, 'source')):
+        if name.endswith('.c'):
+            with open(os.path.join(project_dir, 'source', name)) as source:
+                for priority, isr in ISR_RE.findall(source.read()):
+                    levels[isr] = defines.get(priority, priority)
+    return levels
+
+
+class CallGraph:
+    def __init__(self, frames, unbounded, calls, indirect, taken, indirect_depth):
+        self.frames = frames
+        self.unbounded = unbounded
+        self.calls = calls
+        self.indirect = indirect
+        self.targets = sorted(taken)
+        self.indirect_depth = indirect_depth
+        self.memo = {}
+        self.path = []
+
+    def depth(self, function, level):
+        """Deepest stack usage of a call to function, along with the call chain"""
+        key = (function, level)
+        if key in self.memo:
+            return self.memo[key]
+        if function in self.path:
+            raise StackError('recursion: %s' % ' -> '.join(self.path[self.path.index(function):] + [function]))
+        if function in self.unbounded:
+            raise StackError('unbounded stack frame: %s' % function)
+
+        self.path.append(function)
+        deepest = (0, [])
+        for callee in self.calls.get(function, ()):
+            deepest = max(deepest, self.depth(callee, level), key=lambda result: result[0])
+        if function in self.indirect and level > 0:
+            for target in self.targets:
+                if target not in self.path:
+                    result = self.depth(target, level - 1)
+                    deepest = max(deepest, (result[0], ['(indirect)'] + result[1]), key=lambda result: result[0])
+        self.path.pop()
+
+        result = (self.frames.get(function, 0) + deepest[0], ['%s (%d)' % (function, self.frames.get(function, 0))] + deepest[1])
+        # Only memoize results that don't depend on the functions on the current path
+        if not self.path or not (function in self.indirect and level > 0):
+            self.memo[key] = result
+        return result
+
+
+def read_stack_size(project_dir):
+    with open(os.path.join(project_dir, 'include', 'stack_config.h')) as config:
+        match = re.search(r'#define\s+STACK_SIZE\s+(0x[0-9a-fA-F]+|\d+)', config.read())
+    if not match:
+        raise StackError('STACK_SIZE not found in stack_config.h')
+    return int(match.group(1), 0)
+
+
+def write_header(path, worst_case):
+    lines = [
+        '#ifndef STACK_WORST_CASE_H',
+        '#define\tSTACK_WORST_CASE_H',
+        '',
+        '// Generated by tools/stack_usage.py after each build, do not edit',
+        '',
+        '#define STACK_WORST_CASE        0x%x       // Worst case stack usage in bytes, 0 until derived' % worst_case,
+        '',
+        '#endif\t/* STACK_WORST_CASE_H */',
+    ]
+    content = '\r\n'.join(lines)
+    if os.path.exists(path):
+        with open(path, newline='') as header:
+            if header.read() == content:
+                return
+    with open(path, 'w', newline='') as header:
+        header.write(content)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--objdump', default='xc32-objdump', help='objdump of the toolchain')
+    parser.add_argument('--elf', required=True, help='linked image')
+    parser.add_argument('--build', required=True, help='directory of the object and stack usage files')
+    parser.add_argument('--indirect-depth', type=int, default=4, help='levels of indirect calls to follow')
+    args = parser.parse_args()
+
+    # MPLAB X keeps the debug and production objects apart, pick the ones of the image
+    build_dir = args.build
+    for image_type in ('debug', 'production'):
+        if args.elf.endswith('.%s.elf' % image_type) and os.path.isdir(os.path.join(build_dir, image_type)):
+            build_dir = os.path.join(build_dir, image_type)
+
+    try:
+        frames, unbounded = read_frames(build_dir)
+        calls, indirect, taken, vectors = read_call_graph(args.objdump, args.elf)
+        levels = read_isr_levels(PROJECT_DIR)
+        graph = CallGraph(frames, unbounded, calls, indirect, taken, args.indirect_depth)
+
+        worst_case, chain = graph.depth('main', args.indirect_depth)
+        print('stack: main %d bytes: %s' % (worst_case, ' -> '.join(chain)))
+
+        # ISRs are the targets of the vector dispatch functions, only one ISR per priority level is on the stack
+        deepest = {}
+        for vector in vectors:
+            for isr in calls.get(vector, ()):
+                depth, chain = graph.depth(isr, args.indirect_depth)
+                level = levels.get(isr, isr)
+                if depth > deepest.get(level, (0, []))[0]:
+                    deepest[level] = (depth, chain)
+        for level, (depth, chain) in sorted(deepest.items(), key=lambda item: str(item[0])):
+            print('stack: level %s %d bytes: %s' % (level, depth, ' -> '.join(chain)))
+            worst_case += depth
+    except (StackError, subprocess.CalledProcessError, OSError) as error:
+        print('stack: worst case unknown, %s' % error, file=sys.stderr)
+        write_header(os.path.join(PROJECT_DIR, 'include', 'stack_worst_case.h'), 0)
+        return 1
+
+    stack_size = read_stack_size(PROJECT_DIR)
+    write_header(os.path.join(PROJECT_DIR, 'include', 'stack_worst_case.h'), worst_case)
+    print('stack: worst case %d of %d bytes' % (worst_case, stack_size))
+    if worst_case > stack_size:
+        print('stack: worst case exceeds STACK_SIZE, increase it along with _min_stack_size of the linker script',
+              file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())